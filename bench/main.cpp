@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+
+#include "queue.h"
+#include "slot.h"
+#include "input/dummy.h"
+#include "processing/dummy.h"
+#ifdef PROCESSING_DETECT
+#	include "processing/detect.h"
+#endif
+#include "output/dummy.h"
+
+using namespace Sight;
+
+DEFINE_string(filter, "", "run only benchmarks which name contains this string");
+DEFINE_uint64(iterations, 1000, "iterations of every micro benchmark");
+DEFINE_uint64(duration, 5, "seconds to run every pipeline benchmark");
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// User and system time of the process in microseconds
+int64_t cpuTime() {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+	       usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+bool selected(const std::string& name) {
+	return FLAGS_filter.empty() || name.find(FLAGS_filter) != std::string::npos;
+}
+
+void report(const std::string& name, size_t count, Clock::duration elapsed, int64_t cpu) {
+	double nsec = std::chrono::duration<double, std::nano>(elapsed).count();
+	std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1)
+	          << " count = " << std::setw(9) << count
+	          << ", time = " << std::setw(12) << nsec / count << " ns/op"
+	          << ", rate = " << std::setw(12) << count * 1e9 / nsec << " op/s"
+	          << ", cpu = " << std::setw(9) << (double)cpu / count << " us/op"
+	          << std::endl;
+}
+
+template <typename F>
+void measure(const std::string& name, size_t iterations, F&& f) {
+	if (!selected(name)) {
+		return;
+	}
+
+	// First call warms up caches and lazily created contexts
+	f(0);
+	int64_t cpu = cpuTime();
+	auto begin = Clock::now();
+	for (size_t i = 1; i <= iterations; ++i) {
+		f(i);
+	}
+	report(name, iterations, Clock::now() - begin, cpuTime() - cpu);
+}
+
+// Allocate a frame and draw a gradient, so encoders and scalers get realistic input
+bool fill(AVFrame* frame, int width, int height, AVPixelFormat format) {
+	av_frame_unref(frame);
+	frame->width = width;
+	frame->height = height;
+	frame->format = format;
+	if (av_frame_get_buffer(frame, 0) < 0) {
+		LOG(ERROR) << "Failed to allocate frame buffer";
+		return false;
+	}
+	for (int plane = 0; plane < 4 && frame->data[plane]; ++plane) {
+		int rows = plane == 0 ? height : (height + 1) / 2;
+		for (int y = 0; y < rows; ++y) {
+			for (int x = 0; x < frame->linesize[plane]; ++x) {
+				frame->data[plane][y * frame->linesize[plane] + x] = (uint8_t)(x + y);
+			}
+		}
+	}
+	return true;
+}
+
+std::string resolution(int width, int height) {
+	return std::to_string(width) + "x" + std::to_string(height);
+}
+
+// Exposes protected parts of the output for micro benchmarks
+class Encoder
+	: public Output::Dummy {
+public:
+	using Output::Dummy::Dummy;
+	using Output::Dummy::packet;
+	using Output::Dummy::body;
+};
+
+// Generates frames as fast as the slot ring allows
+class Source
+	: public Input::Dummy {
+public:
+	Source(const json& config,
+	       size_t id,
+	       std::vector<Slot>& slot,
+	       std::vector<Queue<Handle>>& queue,
+	       std::vector<size_t>& queueId) :
+		Input::Dummy(config, id, slot, queue, queueId),
+		mWidth(config["width"]),
+		mHeight(config["height"]) {
+	}
+
+protected:
+	Result read(AVFrame* frame) override {
+		if (frame->width != mWidth || frame->height != mHeight) {
+			if (!fill(frame, mWidth, mHeight, AV_PIX_FMT_YUV420P)) {
+				return Result::error;
+			}
+		}
+		++mNumber;
+		frame->pts = mNumber;
+		frame->pkt_dts = mNumber;
+		frame->coded_picture_number = mNumber;
+		return Result::success;
+	}
+
+private:
+	int mWidth = 0;
+	int mHeight = 0;
+	int mNumber = 0;
+
+};
+
+// Records latency from decode to send
+class Sink
+	: public Output::Dummy {
+public:
+	Sink(const json& config,
+	     size_t id,
+	     std::vector<std::vector<Slot>>& slot,
+	     Queue<Handle>& queue,
+	     bool encode) :
+		Output::Dummy(config, id, slot, queue),
+		mEncode(encode) {
+	}
+
+	// Only valid after the sender is stopped
+	std::vector<int64_t>& latency() {
+		return mLatency;
+	}
+
+protected:
+	bool event(Slot& slot, Event& event) override {
+		if (mEncode) {
+			return Output::Dummy::event(slot, event);
+		}
+		event.mStreamId = slot.streamId();
+		event.mCaptured = slot.captured();
+		return true;
+	}
+
+	bool send(Event& event) override {
+		auto latency = Clock::now() - event.mCaptured;
+		mLatency.push_back(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+		return true;
+	}
+
+private:
+	bool mEncode = false;
+	std::vector<int64_t> mLatency;
+
+};
+
+void benchQueue() {
+	Queue<Handle> queue;
+	measure("queue/put-get", FLAGS_iterations * 1000, [&](size_t i) {
+		queue.put(i);
+		queue.get();
+	});
+
+	std::string name = "queue/producer-consumer";
+	if (selected(name)) {
+		size_t count = FLAGS_iterations * 1000;
+		int64_t cpu = cpuTime();
+		auto begin = Clock::now();
+		std::thread producer([&]() {
+			for (size_t i = 0; i < count; ++i) {
+				queue.put(i);
+				queue.notify();
+			}
+		});
+		for (size_t i = 0; i < count;) {
+			if (queue.ready()) {
+				while (queue.size() > 0) {
+					queue.get();
+					++i;
+				}
+			}
+		}
+		producer.join();
+		report(name, count, Clock::now() - begin, cpuTime() - cpu);
+	}
+}
+
+void benchSlot() {
+	const std::vector<std::pair<int, int>> sources = {{640, 360}, {1280, 720}, {1920, 1080}, {3840, 2160}};
+	struct Conversion {
+		std::string mName;
+		AVPixelFormat mFormat;
+		int mWidth;
+		int mHeight;
+	};
+	const std::vector<Conversion> conversions = {
+		{"rgb24-416x416", AV_PIX_FMT_RGB24, 416, 416},
+		{"rgb24-full", AV_PIX_FMT_RGB24, 0, 0},
+		{"yuvj420p-full", AV_PIX_FMT_YUVJ420P, 0, 0},
+	};
+
+	for (auto& [width, height] : sources) {
+		Slot slot(0, "bench", 1);
+		if (!fill(slot.source(), width, height, AV_PIX_FMT_YUV420P)) {
+			return;
+		}
+		for (auto& c : conversions) {
+			measure("slot/frame/" + resolution(width, height) + "/" + c.mName, FLAGS_iterations, [&](size_t i) {
+				// New picture number defeats the conversion cache
+				slot.source()->coded_picture_number = i + 1;
+				slot.frame(c.mFormat, c.mWidth, c.mHeight);
+			});
+		}
+	}
+}
+
+void benchOutput() {
+	const std::vector<std::pair<int, int>> sources = {{1280, 720}, {1920, 1080}, {3840, 2160}};
+	for (auto& [width, height] : sources) {
+		std::vector<std::vector<Slot>> slot(1);
+		slot[0].push_back(Slot(0, "bench", 1));
+		Queue<Handle> queue;
+		Encoder encoder({{"name", "bench-encoder"}, {"type", "dummy"}}, 0, slot, queue);
+
+		// Fresh slots recreate the encoder, make it look like a running stream
+		auto& s = slot[0][0];
+		if (!fill(s.source(), width, height, AV_PIX_FMT_YUV420P)) {
+			return;
+		}
+		s.source()->pts = 1;
+		s.source()->pkt_dts = 1;
+		s.reset();
+		s.unref();
+
+		measure("output/packet/" + resolution(width, height), FLAGS_iterations / 10 + 1, [&](size_t i) {
+			s.source()->coded_picture_number = i + 1;
+			encoder.packet(s, AV_CODEC_ID_MJPEG);
+		});
+
+		const AVPacket* picture = encoder.packet(s, AV_CODEC_ID_MJPEG);
+		if (picture == nullptr) {
+			return;
+		}
+		json info;
+		info["detect"]["objects"] = json::array();
+		for (size_t id = 0; id < 10; ++id) {
+			info["detect"]["objects"].push_back({
+				{"label", "person"}, {"score", 0.9}, {"x", 10.0 * id}, {"y", 20.0}, {"width", 50.0}, {"height", 120.0}
+			});
+		}
+		measure("output/body/" + resolution(width, height), FLAGS_iterations, [&]([[maybe_unused]]size_t i) {
+			encoder.body(picture, info);
+		});
+	}
+}
+
+// Linear graph of input, depth processors of the type and an output
+void benchPipeline(const std::string& name, int width, int height, size_t depth,
+                   const std::string& type, bool encode) {
+	if (!selected(name)) {
+		return;
+	}
+
+	std::vector<std::vector<Slot>> slot(1);
+	for (size_t slotId = 0; slotId < depth + 2; ++slotId) {
+		slot[0].push_back(Slot(0, "bench", depth + 1));
+	}
+
+	// Queue 0 feeds the output, queue k feeds processor k - 1, as in the pipeline
+	std::vector<Queue<Handle>> queue;
+	for (size_t id = 0; id < depth + 1; ++id) {
+		queue.push_back(Queue<Handle>());
+	}
+
+	std::vector<size_t> sourceOut = {1};
+	Source source({
+		{"name", "bench-input"}, {"type", "dummy"}, {"live", false},
+		{"width", width}, {"height", height}
+	}, 0, slot[0], queue, sourceOut);
+
+	std::vector<std::unique_ptr<Processing::Dummy>> processing;
+	std::vector<std::vector<size_t>> processingOut;
+	processingOut.reserve(depth);
+	for (size_t id = 0; id < depth; ++id) {
+		processingOut.push_back({id + 1 < depth ? id + 2 : 0});
+		json config = {{"name", "bench-processing-" + std::to_string(id)}, {"type", type}};
+#ifdef PROCESSING_DETECT
+		if (type == "detect") {
+			processing.push_back(std::make_unique<Processing::Detect>
+			                     (config, id, slot, queue[id + 1], queue, processingOut.back()));
+			continue;
+		}
+#endif
+		processing.push_back(std::make_unique<Processing::Dummy>
+		                     (config, id, slot, queue[id + 1], queue, processingOut.back()));
+	}
+
+	Sink sink({{"name", "bench-output"}, {"type", "dummy"}}, 0, slot, queue[0], encode);
+
+	int64_t cpu = cpuTime();
+	auto begin = Clock::now();
+	sink.run();
+	for (auto& p : processing) {
+		p->run();
+	}
+	source.run();
+
+	std::this_thread::sleep_for(std::chrono::seconds(FLAGS_duration));
+
+	source.terminate();
+	source.wait();
+	for (auto& p : processing) {
+		p->terminate();
+		p->wait();
+	}
+	sink.terminate();
+	sink.wait();
+	auto elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+	cpu = cpuTime() - cpu;
+
+	auto& latency = sink.latency();
+	if (latency.empty()) {
+		std::cout << name << ": no frames" << std::endl;
+		return;
+	}
+	std::sort(latency.begin(), latency.end());
+	auto percentile = [&](double p) {
+		return latency[std::min(latency.size() - 1, (size_t)(p * latency.size()))] / 1000.0;
+	};
+	std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1)
+	          << " frames = " << latency.size()
+	          << ", fps = " << latency.size() / elapsed
+	          << ", latency p50 = " << percentile(0.5)
+	          << " ms, p90 = " << percentile(0.9)
+	          << " ms, p99 = " << percentile(0.99)
+	          << " ms, max = " << latency.back() / 1000.0
+	          << " ms, cpu = " << (double)cpu / latency.size() << " us/frame"
+	          << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+	google::InitGoogleLogging(argv[0]);
+	gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+	benchQueue();
+	benchSlot();
+	benchOutput();
+
+	benchPipeline("pipeline/passthrough/1920x1080", 1920, 1080, 1, "dummy", false);
+	benchPipeline("pipeline/passthrough-deep/1920x1080", 1920, 1080, 8, "dummy", false);
+	benchPipeline("pipeline/encode/1920x1080", 1920, 1080, 1, "dummy", true);
+#ifdef PROCESSING_DETECT
+	benchPipeline("pipeline/detect/1920x1080", 1920, 1080, 1, "detect", false);
+	benchPipeline("pipeline/detect-encode/3840x2160", 3840, 2160, 1, "detect", true);
+#endif
+
+	return EXIT_SUCCESS;
+}
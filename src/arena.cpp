@@ -0,0 +1,199 @@
+#include "arena.h"
+
+#include <cstring>
+#include <iterator>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include "numa.h"
+
+extern "C" {
+#	include <libavutil/imgutils.h>
+}
+
+namespace Sight {
+
+namespace {
+
+constexpr size_t kHugePage = 2 * 1024 * 1024;
+constexpr size_t kBlock = 4096;
+
+// Fault in every page now, not on the first frame
+void prefault(void* data, size_t size) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	for (size_t offset = 0; offset < size; offset += page) {
+		((volatile uint8_t*)data)[offset] = 0;
+	}
+}
+
+}
+
+std::mutex Arena::sLock;
+uint8_t* Arena::sData = nullptr;
+size_t Arena::sSize = 0;
+size_t Arena::sUsed = 0;
+std::map<uint8_t*, size_t> Arena::sFree;
+std::set<std::pair<size_t, uint8_t*>> Arena::sFit;
+Metrics::Gauge* Arena::sBytes = nullptr;
+Metrics::Gauge* Arena::sStranded = nullptr;
+Metrics::Counter* Arena::sFallback = nullptr;
+
+bool Arena::reserve(size_t size) {
+	std::lock_guard<std::mutex> lock(sLock);
+	if (sData || size == 0) {
+		return false;
+	}
+	sBytes = &Metrics::gauge("sight_arena_bytes", "Frame memory handed out from the arena");
+	sStranded = &Metrics::gauge("sight_arena_stranded_bytes", "Freed arena memory between blocks in use, only reused by buffers that fit");
+	sFallback = &Metrics::counter("sight_arena_fallback_total", "Frame buffers allocated on the heap with the arena full");
+	size = (size + kHugePage - 1) & ~(kHugePage - 1);
+
+	const char* mode = "huge pages";
+#if defined(__linux__)
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+#elif defined(__FreeBSD__)
+	// Superpages back an aligned mapping once every page of it is touched
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_ALIGNED_SUPER, -1, 0);
+	if (data != MAP_FAILED) {
+		mode = "superpages";
+		prefault(data, size);
+	}
+#else
+	void* data = MAP_FAILED;
+#endif
+	if (data == MAP_FAILED) {
+		// No reserved huge pages, align to a huge page so the kernel can back it transparently
+		void* raw = mmap(NULL, size + kHugePage, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (raw == MAP_FAILED) {
+			LOG(ERROR) << "Could not reserve frame arena of " << size / (1024 * 1024) << " MiB, error = "
+			           << std::strerror(errno);
+			return false;
+		}
+		uintptr_t aligned = ((uintptr_t)raw + kHugePage - 1) & ~(kHugePage - 1);
+		if (aligned > (uintptr_t)raw) {
+			munmap(raw, aligned - (uintptr_t)raw);
+		}
+		munmap((uint8_t*)aligned + size, (uintptr_t)raw + kHugePage - aligned);
+		data = (void*)aligned;
+		mode = "normal pages";
+#ifdef MADV_HUGEPAGE
+		if (madvise(data, size, MADV_HUGEPAGE) == 0) {
+			mode = "transparent huge pages";
+		}
+#endif
+		prefault(data, size);
+	}
+
+	sData = (uint8_t*)data;
+	sSize = size;
+	sUsed = 0;
+	LOG(INFO) << "Frame arena of " << size / (1024 * 1024) << " MiB on " << mode;
+	return true;
+}
+
+AVBufferRef* Arena::buffer(size_t size, int node) {
+	size_t block = (size + kBlock - 1) & ~(kBlock - 1);
+	uint8_t* data = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(sLock);
+		if (sData) {
+			// Smallest free block that fits, the rest of it stays free
+			auto fit = sFit.lower_bound({block, nullptr});
+			if (fit != sFit.end()) {
+				auto [size, start] = *fit;
+				sFit.erase(fit);
+				sFree.erase(start);
+				if (size > block) {
+					insert(start + block, size - block);
+				}
+				sStranded->add(-(int64_t)block);
+				data = start;
+			} else if (sUsed + block <= sSize) {
+				data = sData + sUsed;
+				sUsed += block;
+			} else {
+				sFallback->add();
+			}
+			if (data) {
+				sBytes->add(block);
+			}
+		}
+	}
+	if (!data) {
+		AVBufferRef* buffer = node >= 0 ? Numa::buffer(size, node) : NULL;
+		return buffer ? buffer : av_buffer_alloc(size);
+	}
+
+	AVBufferRef* buffer = av_buffer_create(data, size, release, reinterpret_cast<void*>(block), 0);
+	if (!buffer) {
+		release(reinterpret_cast<void*>(block), data);
+	}
+	return buffer;
+}
+
+bool Arena::allocate(AVFrame* frame, int align, int node) {
+	AVPixelFormat format = (AVPixelFormat)frame->format;
+	int size = av_image_get_buffer_size(format, frame->width, frame->height, align);
+	if (size < 0) {
+		return false;
+	}
+	AVBufferRef* buffer = Arena::buffer(size, node);
+	if (!buffer) {
+		return false;
+	}
+	if (av_image_fill_arrays(frame->data, frame->linesize, buffer->data, format,
+	                         frame->width, frame->height, align) < 0) {
+		av_buffer_unref(&buffer);
+		return false;
+	}
+	frame->buf[0] = buffer;
+	frame->extended_data = frame->data;
+	return true;
+}
+
+bool Arena::contains(const void* data) {
+	return sData && data >= sData && data < sData + sSize;
+}
+
+void Arena::release(void* opaque, uint8_t* data) {
+	size_t block = reinterpret_cast<uintptr_t>(opaque);
+	std::lock_guard<std::mutex> lock(sLock);
+	sBytes->add(-(int64_t)block);
+	sStranded->add(block);
+
+	// Merge with the free neighbours, a free run at the end goes back to the bump space
+	auto next = sFree.find(data + block);
+	if (next != sFree.end()) {
+		block += next->second;
+		erase(next);
+	}
+	auto previous = sFree.lower_bound(data);
+	if (previous != sFree.begin() && std::prev(previous)->first + std::prev(previous)->second == data) {
+		--previous;
+		data = previous->first;
+		block += previous->second;
+		erase(previous);
+	}
+	if (data + block == sData + sUsed) {
+		sUsed -= block;
+		sStranded->add(-(int64_t)block);
+	} else {
+		insert(data, block);
+	}
+}
+
+void Arena::insert(uint8_t* data, size_t size) {
+	sFree.emplace(data, size);
+	sFit.emplace(size, data);
+}
+
+void Arena::erase(std::map<uint8_t*, size_t>::iterator free) {
+	sFit.erase({free->second, free->first});
+	sFree.erase(free);
+}
+
+}
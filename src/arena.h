@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+
+extern "C" {
+#	include <libavutil/buffer.h>
+#	include <libavutil/frame.h>
+}
+
+#include "metrics.h"
+
+namespace Sight {
+
+// Frame memory carved from one pre-faulted region, freed blocks are merged with their free neighbours and reused
+// by the smallest that fits
+class Arena {
+public:
+	// Rows are aligned for the widest SIMD loads in swscale and the models
+	static constexpr int kAlign = 64;
+
+	// Huge pages first (superpages on FreeBSD), then transparent huge pages, then normal pages, every page touched once
+	static bool reserve(size_t size);
+	// From the arena while it has room, after that or when no arena is reserved from memory bound to the node,
+	// or from the heap without one
+	static AVBufferRef* buffer(size_t size, int node = -1);
+	// Fills data and linesize of a frame with format, width and height set, one buffer for all planes
+	static bool allocate(AVFrame* frame, int align = kAlign, int node = -1);
+	static bool contains(const void* data);
+
+private:
+	static void release(void* opaque, uint8_t* data);
+	// Both free indexes, the caller holds the lock
+	static void insert(uint8_t* data, size_t size);
+	static void erase(std::map<uint8_t*, size_t>::iterator free);
+
+	static std::mutex sLock;
+	static uint8_t* sData;
+	static size_t sSize;
+	static size_t sUsed;
+	// Free blocks below the bump pointer, by address to merge and by size to fit
+	static std::map<uint8_t*, size_t> sFree;
+	static std::set<std::pair<size_t, uint8_t*>> sFit;
+
+	static Metrics::Gauge* sBytes;
+	static Metrics::Gauge* sStranded;
+	static Metrics::Counter* sFallback;
+
+};
+
+}
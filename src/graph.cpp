@@ -0,0 +1,192 @@
+#include "graph.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace Sight {
+
+Graph::Graph(const json& config) {
+	static const std::vector<std::pair<std::string, Kind>> sections = {
+		{"input", Kind::input},
+		{"processing", Kind::processing},
+		{"output", Kind::output}
+	};
+
+	// Nodes are numbered inputs first, then processing, then outputs
+	std::unordered_map<std::string, size_t> ids;
+	for (auto& [section, kind] : sections) {
+		if (!config.contains(section) || !config[section].is_array()) {
+			continue;
+		}
+		size_t index = 0;
+		for (auto& node : config[section]) {
+			Node n;
+			n.mKind = kind;
+			n.mIndex = index++;
+			if (node.contains("name") && node["name"].is_string()) {
+				n.mName = node["name"];
+			}
+			ids.emplace(n.mName, mNode.size());
+			mNode.push_back(n);
+		}
+		if (kind == Kind::input) {
+			mInputs = index;
+		} else if (kind == Kind::processing) {
+			mProcessing = index;
+		} else {
+			mOutputs = index;
+		}
+	}
+
+	// Unknown names are left to validation
+	for (auto& [section, kind] : sections) {
+		if (kind == Kind::output || !config.contains(section) || !config[section].is_array()) {
+			continue;
+		}
+		for (size_t index = 0; index < config[section].size(); ++index) {
+			auto& node = config[section][index];
+			if (!node.contains("out") || !node["out"].is_array()) {
+				continue;
+			}
+			auto& out = mNode[this->node(kind, index)].mOut;
+			for (auto& name : node["out"]) {
+				if (!name.is_string()) {
+					continue;
+				}
+				auto it = ids.find(name);
+				if (it != ids.end()) {
+					out.push_back(it->second);
+				}
+			}
+		}
+	}
+
+	// Kahn's algorithm, nodes left over sit on a cycle
+	std::vector<size_t> in(mNode.size(), 0);
+	for (auto& n : mNode) {
+		for (auto& to : n.mOut) {
+			++in[to];
+		}
+	}
+	mOrder.reserve(mNode.size());
+	for (size_t id = 0; id < mNode.size(); ++id) {
+		if (in[id] == 0) {
+			mOrder.push_back(id);
+		}
+	}
+	for (size_t head = 0; head < mOrder.size(); ++head) {
+		for (auto& to : mNode[mOrder[head]].mOut) {
+			if (--in[to] == 0) {
+				mOrder.push_back(to);
+			}
+		}
+	}
+	if (!acyclic()) {
+		return;
+	}
+
+	// Sinks come last in the order, so walking it backwards sees successors first
+	mSlotSize.assign(mNode.size(), 0);
+	mStageCount.assign(mNode.size(), 0);
+	for (auto it = mOrder.rbegin(); it != mOrder.rend(); ++it) {
+		auto& n = mNode[*it];
+		for (auto& to : n.mOut) {
+			mSlotSize[*it] = std::max(mSlotSize[*it], mSlotSize[to] + 1);
+			mStageCount[*it] += mStageCount[to] + 1;
+		}
+	}
+}
+
+bool Graph::acyclic() const {
+	return mOrder.size() == mNode.size();
+}
+
+std::vector<std::string> Graph::cycle() const {
+	if (acyclic()) {
+		return {};
+	}
+
+	std::vector<bool> sorted(mNode.size(), false);
+	for (auto& id : mOrder) {
+		sorted[id] = true;
+	}
+	std::vector<std::vector<size_t>> from(mNode.size());
+	for (size_t id = 0; id < mNode.size(); ++id) {
+		for (auto& to : mNode[id].mOut) {
+			from[to].push_back(id);
+		}
+	}
+
+	// Every unsorted node has an unsorted predecessor, walking back must come around
+	size_t id = 0;
+	while (sorted[id]) {
+		++id;
+	}
+	std::vector<size_t> seen(mNode.size(), mNode.size());
+	std::vector<size_t> path;
+	while (seen[id] == mNode.size()) {
+		seen[id] = path.size();
+		path.push_back(id);
+		for (auto& prev : from[id]) {
+			if (!sorted[prev]) {
+				id = prev;
+				break;
+			}
+		}
+	}
+
+	std::vector<std::string> result;
+	result.push_back(mNode[id].mName);
+	for (size_t step = path.size(); step > seen[id]; --step) {
+		result.push_back(mNode[path[step - 1]].mName);
+	}
+	return result;
+}
+
+size_t Graph::node(Kind kind, size_t index) const {
+	switch (kind) {
+		case Kind::input:
+			return index;
+		case Kind::processing:
+			return mInputs + index;
+		case Kind::output:
+			return mInputs + mProcessing + index;
+	}
+	return index;
+}
+
+const Graph::Node& Graph::operator[](size_t id) const {
+	return mNode[id];
+}
+
+size_t Graph::size() const {
+	return mNode.size();
+}
+
+const std::vector<size_t>& Graph::order() const {
+	return mOrder;
+}
+
+size_t Graph::slotSize(size_t id) const {
+	return mSlotSize[id];
+}
+
+size_t Graph::stageCount(size_t id) const {
+	return mStageCount[id];
+}
+
+std::vector<size_t> Graph::queueIds(size_t id) const {
+	std::vector<size_t> result;
+	result.reserve(mNode[id].mOut.size());
+	for (auto& to : mNode[id].mOut) {
+		auto& n = mNode[to];
+		if (n.mKind == Kind::output) {
+			result.push_back(n.mIndex);
+		} else if (n.mKind == Kind::processing) {
+			result.push_back(mOutputs + n.mIndex);
+		}
+	}
+	return result;
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace Sight {
+
+using json = nlohmann::json;
+
+// Pipeline nodes and their connections, compiled once from the config
+class Graph {
+public:
+	enum class Kind {
+		input,
+		processing,
+		output
+	};
+
+	struct Node {
+		Kind mKind = Kind::input;
+		size_t mIndex = 0;
+		std::string mName;
+		std::vector<size_t> mOut;
+	};
+
+	Graph(const json& config);
+
+	bool acyclic() const;
+	std::vector<std::string> cycle() const;
+
+	size_t node(Kind kind, size_t index) const;
+	const Node& operator[](size_t id) const;
+	size_t size() const;
+	const std::vector<size_t>& order() const;
+
+	// Longest path in processing hops, the number of slots a stream needs in flight
+	size_t slotSize(size_t id) const;
+	// Number of paths to outputs, every one of them releases the slot once
+	size_t stageCount(size_t id) const;
+	// Queues in the order of the out array, outputs first, then processing
+	std::vector<size_t> queueIds(size_t id) const;
+
+private:
+	size_t mInputs = 0;
+	size_t mProcessing = 0;
+	size_t mOutputs = 0;
+
+	std::vector<Node> mNode;
+	std::vector<size_t> mOrder;
+
+	std::vector<size_t> mSlotSize;
+	std::vector<size_t> mStageCount;
+
+};
+
+}
@@ -0,0 +1,350 @@
+#include "cache.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+namespace Sight::Input {
+
+namespace {
+
+// Frames start one page after the header
+constexpr size_t kHeaderSize = 4096;
+constexpr uint32_t kVersion = 2;
+constexpr char kMagic[8] = {'S', 'I', 'G', 'H', 'T', 'R', 'A', 'W'};
+
+// FNV-1a of the url, stable across builds unlike std::hash
+uint64_t hash(const std::string& text) {
+	uint64_t result = 14695981039346656037ull;
+	for (unsigned char c : text) {
+		result = (result ^ c) * 1099511628211ull;
+	}
+	return result;
+}
+
+void unmap(void* opaque, uint8_t* data) {
+	munmap(data, reinterpret_cast<uintptr_t>(opaque));
+}
+
+}
+
+Cache::Cache(const json& config,
+             size_t id,
+             std::vector<Slot>& slot,
+             std::vector<Queue<Handle>>& queue,
+             std::vector<size_t>& queueId) :
+	Stream(config, id, slot, queue, queueId) {
+	if (config.contains("file")) {
+		mFile = config["file"];
+	}
+	if (config.contains("frames")) {
+		mLimit = config["frames"];
+	}
+	if (config.contains("fps")) {
+		mFps = config["fps"];
+	}
+	mSource = hash(config.value("url", ""));
+}
+
+Cache::Cache(Cache&& other) noexcept :
+	Stream(std::move(other)),
+	mFile(std::move(other.mFile)),
+	mLimit(std::exchange(other.mLimit, 0)),
+	mFps(std::exchange(other.mFps, 0.0)),
+	mSource(std::exchange(other.mSource, 0)),
+	mBuffer(std::exchange(other.mBuffer, nullptr)),
+	mFrames(std::move(other.mFrames)),
+	mRate(std::exchange(other.mRate, 25.0)),
+	mIndex(std::exchange(other.mIndex, 0)),
+	mNumber(std::exchange(other.mNumber, 0)) {
+}
+
+Cache::~Cache() {
+	for (auto& frame : mFrames) {
+		av_frame_free(&frame);
+	}
+	mFrames.clear();
+	av_buffer_unref(&mBuffer);
+}
+
+bool Cache::validate(const json& config) {
+	if (!Stream::validate(config)) {
+		return false;
+	}
+	if (config.contains("file") && (!config["file"].is_string() || config["file"].empty())) {
+		LOG(ERROR) << "File is not string or empty";
+		return false;
+	}
+	if (config.contains("frames") && (!config["frames"].is_number_unsigned() || config["frames"] == 0)) {
+		LOG(ERROR) << "Frames is not positive number";
+		return false;
+	}
+	if (config.contains("fps") && (!config["fps"].is_number() || config["fps"] < 0)) {
+		LOG(ERROR) << "Fps is not a non negative number";
+		return false;
+	}
+	return true;
+}
+
+bool Cache::start() {
+	mIndex = 0;
+	mBegin = std::chrono::steady_clock::now();
+
+	// Decoding happens once, restarts replay what is already cached
+	if (mBuffer) {
+		return true;
+	}
+	if (!mFile.empty() && map()) {
+		return true;
+	}
+	return decode();
+}
+
+void Cache::stop() {
+	// Cached frames outlive restarts, the stream was closed after decoding
+}
+
+Dummy::Result Cache::read(AVFrame* frame) {
+	if (mFrames.empty()) {
+		return Result::eof;
+	}
+
+	// Pace to the configured rate, zero means as fast as slots are free
+	if (mFps > 0.0) {
+		auto due = mBegin + std::chrono::microseconds((int64_t)(mNumber * 1000000.0 / mFps));
+		std::this_thread::sleep_until(due);
+	}
+
+	av_frame_unref(frame);
+	if (av_frame_ref(frame, mFrames[mIndex]) < 0) {
+		LOG(ERROR) << mName << ": Failed to reference cached frame";
+		return Result::error;
+	}
+	mIndex = mIndex + 1 < mFrames.size() ? mIndex + 1 : 0;
+
+	frame->pts = mNumber;
+	frame->pkt_dts = mNumber;
+	frame->coded_picture_number = ++mNumber;
+	return Result::success;
+}
+
+AVRational Cache::timeBase() const {
+	// Frame number is the timestamp
+	double rate = mFps > 0.0 ? mFps : mRate;
+	return {1000, (int)(rate * 1000.0)};
+}
+
+bool Cache::decode() {
+	if (!Stream::start()) {
+		Stream::stop();
+		return false;
+	}
+
+	AVRational rate = mFormatContext->streams[mVideoStream]->avg_frame_rate;
+	if (rate.num > 0 && rate.den > 0) {
+		mRate = av_q2d(rate);
+	}
+
+	// Each frame goes into the cache as it is decoded, so only one decoded frame is alive at a time
+	Header header = {};
+	Storage storage;
+	size_t dropped = 0;
+	AVFrame* frame = av_frame_alloc();
+	bool ok = frame != NULL;
+	while (ok && header.mCount < mLimit) {
+		Result result = Stream::read(frame);
+		if (result == Result::success) {
+			// Mid stream resolution changes are dropped, every cached frame has the same layout
+			if (!storage.mData && !create(frame, header, storage)) {
+				ok = false;
+			} else if (frame->width == header.mWidth && frame->height == header.mHeight && frame->format == header.mFormat) {
+				av_image_copy_to_buffer(storage.mData + kHeaderSize + header.mCount * header.mStride, header.mStride,
+				                        frame->data, frame->linesize,
+				                        (AVPixelFormat)header.mFormat, header.mWidth, header.mHeight, 32);
+				++header.mCount;
+			} else {
+				++dropped;
+			}
+			av_frame_unref(frame);
+		} else if (result == Result::eof) {
+			break;
+		} else if (result == Result::changed || result == Result::error) {
+			ok = false;
+		}
+	}
+	av_frame_free(&frame);
+	Stream::stop();
+
+	if (dropped > 0) {
+		LOG(WARNING) << mName << ": Dropped " << dropped << " frames with another layout";
+	}
+	if (ok && header.mCount == 0) {
+		LOG(ERROR) << mName << ": No frames decoded";
+		ok = false;
+	}
+	if (ok) {
+		ok = commit(header, storage);
+	}
+	if (!ok && storage.mData) {
+		munmap(storage.mData, storage.mSize);
+		if (!mFile.empty()) {
+			unlink((mFile + ".tmp").c_str());
+		}
+	}
+	return ok;
+}
+
+bool Cache::create(const AVFrame* frame, Header& header, Storage& storage) {
+	std::memcpy(header.mMagic, kMagic, sizeof(kMagic));
+	header.mVersion = kVersion;
+	header.mWidth = frame->width;
+	header.mHeight = frame->height;
+	header.mFormat = frame->format;
+	header.mRate = mRate;
+	header.mSource = mSource;
+	header.mLimit = mLimit;
+
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)header.mFormat);
+	if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL))) {
+		LOG(ERROR) << mName << ": Unsupported pixel format = " << header.mFormat;
+		return false;
+	}
+	int size = av_image_get_buffer_size((AVPixelFormat)header.mFormat, header.mWidth, header.mHeight, 32);
+	if (size < 0) {
+		LOG(ERROR) << mName << ": Could not compute frame size";
+		return false;
+	}
+	header.mStride = (size + 63) & ~63;
+
+	// Room for the frame limit, pages past the last frame are never touched and get trimmed in commit
+	storage.mSize = kHeaderSize + mLimit * header.mStride;
+	void* data = MAP_FAILED;
+	if (mFile.empty()) {
+		data = mmap(NULL, storage.mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	} else {
+		// Written next to the cache file and renamed once complete, a killed run leaves no file that maps
+		std::string temporary = mFile + ".tmp";
+		int fd = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0 || ftruncate(fd, storage.mSize) < 0) {
+			LOG(ERROR) << mName << ": Could not create cache file " << temporary << ", error = " << std::strerror(errno);
+			if (fd >= 0) {
+				close(fd);
+			}
+			return false;
+		}
+		data = mmap(NULL, storage.mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+	}
+	if (data == MAP_FAILED) {
+		LOG(ERROR) << mName << ": Could not map " << storage.mSize << " bytes for frame cache, error = " << std::strerror(errno);
+		return false;
+	}
+	storage.mData = (uint8_t*)data;
+	return true;
+}
+
+bool Cache::commit(Header& header, Storage& storage) {
+	size_t total = kHeaderSize + header.mCount * header.mStride;
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t mapped = (total + page - 1) & ~(page - 1);
+	if (mapped < storage.mSize) {
+		munmap(storage.mData + mapped, storage.mSize - mapped);
+		storage.mSize = mapped;
+	}
+	std::memcpy(storage.mData, &header, sizeof(header));
+
+	if (!mFile.empty()) {
+		std::string temporary = mFile + ".tmp";
+		if (truncate(temporary.c_str(), total) < 0 || msync(storage.mData, total, MS_SYNC) < 0 ||
+		    rename(temporary.c_str(), mFile.c_str()) < 0) {
+			LOG(ERROR) << mName << ": Could not write cache file " << mFile << ", error = " << std::strerror(errno);
+			return false;
+		}
+	}
+
+	mBuffer = av_buffer_create(storage.mData, storage.mSize, unmap, reinterpret_cast<void*>(storage.mSize), 0);
+	if (!mBuffer) {
+		LOG(ERROR) << mName << ": Failed to wrap frame cache";
+		return false;
+	}
+	storage.mData = NULL;
+	slice(header);
+
+	LOG(INFO) << mName << ": Cached " << header.mCount << " frames, " << total / (1024 * 1024) << " MiB"
+	          << (mFile.empty() ? std::string(" in memory") : ", file " + mFile);
+	return true;
+}
+
+bool Cache::map() {
+	int fd = open(mFile.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < kHeaderSize) {
+		close(fd);
+		return false;
+	}
+	size_t total = st.st_size;
+
+	// Private mapping so a stray writer gets its own copy of the page
+	void* data = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		LOG(ERROR) << mName << ": Could not map cache file " << mFile << ", error = " << std::strerror(errno);
+		return false;
+	}
+
+	Header header;
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.mMagic, kMagic, sizeof(kMagic)) != 0 || header.mVersion != kVersion ||
+	    header.mCount == 0 || header.mCount > header.mLimit || total != kHeaderSize + header.mCount * header.mStride ||
+	    av_image_get_buffer_size((AVPixelFormat)header.mFormat, header.mWidth, header.mHeight, 32) > (int64_t)header.mStride) {
+		LOG(WARNING) << mName << ": Cache file " << mFile << " is not valid, decoding again";
+		munmap(data, total);
+		return false;
+	}
+	if (header.mSource != mSource || header.mLimit != mLimit) {
+		LOG(WARNING) << mName << ": Cache file " << mFile << " holds another url or frame count, decoding again";
+		munmap(data, total);
+		return false;
+	}
+	madvise(data, total, MADV_WILLNEED);
+
+	mBuffer = av_buffer_create((uint8_t*)data, total, unmap, reinterpret_cast<void*>(total), 0);
+	if (!mBuffer) {
+		munmap(data, total);
+		LOG(ERROR) << mName << ": Failed to wrap cache file";
+		return false;
+	}
+	mRate = header.mRate;
+	slice(header);
+
+	LOG(INFO) << mName << ": Mapped " << header.mCount << " cached frames from " << mFile;
+	return true;
+}
+
+void Cache::slice(const Header& header) {
+	for (size_t id = 0; id < header.mCount; ++id) {
+		AVFrame* frame = av_frame_alloc();
+		if (!frame) {
+			LOG(ERROR) << mName << ": Failed to allocate memory for AVFrame";
+			break;
+		}
+		frame->width = header.mWidth;
+		frame->height = header.mHeight;
+		frame->format = header.mFormat;
+		av_image_fill_arrays(frame->data, frame->linesize, mBuffer->data + kHeaderSize + id * header.mStride,
+		                     (AVPixelFormat)header.mFormat, header.mWidth, header.mHeight, 32);
+		frame->buf[0] = av_buffer_ref(mBuffer);
+		mFrames.push_back(frame);
+	}
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "stream.h"
+
+namespace Sight::Input {
+
+class Cache
+	: public Stream {
+public:
+	Cache(const json& config,
+	      size_t id,
+	      std::vector<Slot>& slot,
+	      std::vector<Queue<Handle>>& queue,
+	      std::vector<size_t>& queueId);
+	Cache(const Cache& other) = delete;
+	Cache(Cache&& other) noexcept;
+	~Cache();
+
+	static bool validate(const json& config);
+
+protected:
+	bool start() override;
+	void stop() override;
+	Result read(AVFrame* frame) override;
+	AVRational timeBase() const override;
+
+private:
+	struct Header {
+		char mMagic[8];
+		uint32_t mVersion;
+		int32_t mWidth;
+		int32_t mHeight;
+		int32_t mFormat;
+		uint64_t mCount;
+		uint64_t mStride;
+		double mRate;
+		uint64_t mSource;
+		uint64_t mLimit;
+	};
+
+	// Mapping the frames are decoded into, sized for the frame limit until commit trims it
+	struct Storage {
+		uint8_t* mData = NULL;
+		size_t mSize = 0;
+	};
+
+	bool decode();
+	bool create(const AVFrame* frame, Header& header, Storage& storage);
+	bool commit(Header& header, Storage& storage);
+	bool map();
+	void slice(const Header& header);
+
+	std::string mFile = "";
+	size_t mLimit = 300;
+	double mFps = 0.0;
+	uint64_t mSource = 0;
+
+	// One buffer holds every frame, slots reference it instead of copying
+	AVBufferRef* mBuffer = NULL;
+	std::vector<AVFrame*> mFrames;
+	double mRate = 25.0;
+
+	size_t mIndex = 0;
+	int64_t mNumber = 0;
+	std::chrono::steady_clock::time_point mBegin;
+
+};
+
+}
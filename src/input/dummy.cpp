@@ -1,21 +1,49 @@
 #include "dummy.h"
 
+#include <algorithm>
 #include <set>
 
 #include <glog/logging.h>
 
+#include "numa.h"
+#include "trace.h"
+
 namespace Sight::Input {
 
 Dummy::Dummy(const json& config,
              size_t id,
              std::vector<Slot>& slot,
-             std::vector<Queue<uint32_t>>& queue,
+             std::vector<Queue<Handle>>& queue,
              std::vector<size_t>& queueId) :
 	Module(config, id),
 	mSlot(slot),
 	mQueue(queue),
 	mQueueId(queueId) {
 	mLive = config["live"];
+	mMin = mSlot.size();
+	if (config.contains("slots") && config["slots"].contains("min")) {
+		mMin = std::min(config["slots"]["min"].get<size_t>(), mSlot.size());
+	}
+	mActive = mMin;
+	mWindow = std::chrono::steady_clock::now();
+	if (config.contains("reconnect")) {
+		auto& reconnect = config["reconnect"];
+		mRetryDelay = std::chrono::milliseconds(reconnect.value("delay", mRetryDelay.count()));
+		mRetryMaxDelay = std::chrono::milliseconds(reconnect.value("max_delay", mRetryMaxDelay.count()));
+		mRetryFactor = reconnect.value("factor", mRetryFactor);
+		mRetryJitter = reconnect.value("jitter", mRetryJitter);
+		mRetryAttempts = reconnect.value("attempts", mRetryAttempts);
+		mRetryDuration = std::chrono::milliseconds(reconnect.value("duration", mRetryDuration.count()));
+		mRetryErrors = reconnect.value("errors", mRetryErrors);
+	}
+	mRandom.seed(std::random_device()() + id);
+	mDecodeTime = &Metrics::histogram("sight_decode_seconds", "Time to read and decode a frame", labels());
+	mSlotBusy = &Metrics::gauge("sight_slot_busy", "Slots of the stream ring held by the pipeline", labels());
+	mSlotActive = &Metrics::gauge("sight_slot_active", "Slots in the stream ring", labels());
+	mReconnects = &Metrics::counter("sight_reconnects_total", "Reconnect attempts of the input", labels());
+	mSlotBytes = &Metrics::gauge("sight_slot_bytes", "Frame memory held by the stream ring", labels());
+	mNodeBytes = &Numa::bytes(mThread.node());
+	mSlotActive->set(mActive);
 	mFrame = av_frame_alloc();
 	if (!mFrame) {
 		LOG(ERROR) << mName << ": Failed to allocated memory for AVFrame";
@@ -27,10 +55,40 @@ Dummy::Dummy(Dummy&& other) noexcept :
 	mLive(std::exchange(other.mLive, false)),
 	mSlot(other.mSlot),
 	mQueue(other.mQueue),
-	mQueueId(other.mQueueId) {
+	mQueueId(other.mQueueId),
+	mFrame(std::exchange(other.mFrame, nullptr)),
+	mSlotId(std::exchange(other.mSlotId, 0)),
+	mMin(std::exchange(other.mMin, 0)),
+	mActive(std::exchange(other.mActive, 0)),
+	mPeak(std::exchange(other.mPeak, 0)),
+	mWindow(other.mWindow),
+	mRetryDelay(other.mRetryDelay),
+	mRetryMaxDelay(other.mRetryMaxDelay),
+	mRetryFactor(other.mRetryFactor),
+	mRetryJitter(other.mRetryJitter),
+	mRetryAttempts(other.mRetryAttempts),
+	mRetryDuration(other.mRetryDuration),
+	mRetryErrors(other.mRetryErrors),
+	mRetrying(std::exchange(other.mRetrying, false)),
+	mRetry(std::exchange(other.mRetry, 0)),
+	mErrors(std::exchange(other.mErrors, 0)),
+	mBackoff(other.mBackoff),
+	mRetryAt(other.mRetryAt),
+	mRetrySince(other.mRetrySince),
+	mRandom(other.mRandom),
+	mDecodeTime(other.mDecodeTime),
+	mSlotBusy(other.mSlotBusy),
+	mSlotActive(other.mSlotActive),
+	mSlotBytes(other.mSlotBytes),
+	mReconnects(other.mReconnects),
+	mNodeBytes(other.mNodeBytes),
+	mNodeReported(std::exchange(other.mNodeReported, 0)) {
 }
 
 Dummy::~Dummy() {
+	if (mNodeBytes) {
+		mNodeBytes->add(-mNodeReported);
+	}
 	av_frame_free(&mFrame);
 }
 
@@ -42,6 +100,65 @@ bool Dummy::validate(const json& config) {
 		LOG(ERROR) << "Live is not exists or not boolean";
 		return false;
 	}
+	if (config.contains("copies") && (!config["copies"].is_number_unsigned() || config["copies"] == 0)) {
+		LOG(ERROR) << "Copies is not positive number";
+		return false;
+	}
+	if (config.contains("segments")) {
+		// Pipeline::expand replaces valid segments with one input per segment
+		LOG(ERROR) << "Segments is not positive number or input is live";
+		return false;
+	}
+	if (config.contains("segment")) {
+		auto& segment = config["segment"];
+		if (!segment.is_object() || !segment.contains("group") || !segment["group"].is_string() ||
+		    !segment.contains("index") || !segment["index"].is_number_unsigned() ||
+		    !segment.contains("count") || !segment["count"].is_number_unsigned() ||
+		    segment["index"] >= segment["count"]) {
+			LOG(ERROR) << "Segment is not an object with group, index and count";
+			return false;
+		}
+	}
+	if (config.contains("slots")) {
+		auto& slots = config["slots"];
+		if (!slots.is_object()) {
+			LOG(ERROR) << "Slots is not an object";
+			return false;
+		}
+		for (auto& key : {"min", "max"}) {
+			if (slots.contains(key) &&
+			    (!slots[key].is_number_unsigned() || slots[key] == 0 || slots[key] > 65536)) {
+				LOG(ERROR) << "Slots " << key << " is not a number from 1 to 65536";
+				return false;
+			}
+		}
+		if (slots.contains("min") && slots.contains("max") && slots["min"] > slots["max"]) {
+			LOG(ERROR) << "Slots min is greater than max";
+			return false;
+		}
+	}
+	if (config.contains("reconnect")) {
+		auto& reconnect = config["reconnect"];
+		if (!reconnect.is_object()) {
+			LOG(ERROR) << "Reconnect is not an object";
+			return false;
+		}
+		for (auto& key : {"delay", "max_delay", "attempts", "duration", "errors"}) {
+			if (reconnect.contains(key) && !reconnect[key].is_number_unsigned()) {
+				LOG(ERROR) << "Reconnect " << key << " is not unsigned number";
+				return false;
+			}
+		}
+		if (reconnect.contains("factor") && (!reconnect["factor"].is_number() || reconnect["factor"] < 1.0)) {
+			LOG(ERROR) << "Reconnect factor is not a number of at least 1";
+			return false;
+		}
+		if (reconnect.contains("jitter") &&
+		    (!reconnect["jitter"].is_number() || reconnect["jitter"] < 0.0 || reconnect["jitter"] > 1.0)) {
+			LOG(ERROR) << "Reconnect jitter is not a number from 0 to 1";
+			return false;
+		}
+	}
 	if (config.contains("out") && config["out"].is_array() && !config["out"].empty()) {
 		auto& out = config["out"];
 		std::set<std::string> outUnique;
@@ -67,29 +184,50 @@ bool Dummy::validate(const json& config) {
 }
 
 void Dummy::task() {
+	// Idle and reconnecting inputs shrink too, not only those that deliver frames
+	resize();
+	if (mRetrying) {
+		reconnect();
+		return;
+	}
+
 	AVFrame* frame = mFrame;
-	auto& slot = mSlot[mSlotId];
-	if (mLive) {
-		if (slot.ready()) {
-			frame = slot.source();
-		}
-	} else {
-		if (!slot.ready()) {
-			slot.wait();
-		}
-		frame = slot.source();
+	Slot* free = take();
+	if (!free && !mLive) {
+		// Offline streams never drop, wait for the next slot in turn
+		mSlot[mSlotId].wait();
+		free = &mSlot[mSlotId];
+	}
+	if (free) {
+		frame = free->source();
 	}
+	auto& slot = mSlot[mSlotId];
 
+	int64_t begin = Trace::now();
 	Result result = read(frame);
 	switch (result) {
 		case Result::success:
+			mErrors = 0;
+			mFramesIn->add();
+			mDecodeTime->observe(Trace::now() - begin);
 			if (frame != mFrame) {
-				slot.reset();
+				slot.reset(timeBase());
+				Trace::complete("decode", begin, mId, mSlotId, frame->coded_picture_number);
 				for (auto& queueId : mQueueId) {
-					mQueue[queueId].put(pack(mId, mSlotId, true));
+					mQueue[queueId].put(pack(mId, mSlotId, slot.generation(), true));
 					mQueue[queueId].notify();
 				}
-				mSlotId = mSlotId + 1 < mSlot.size() ? mSlotId + 1 : 0;
+				mFramesOut->add();
+				mSlotId = mSlotId + 1 < mActive ? mSlotId + 1 : 0;
+
+				size_t busy = 0;
+				for (size_t id = 0; id < mActive; ++id) {
+					busy += mSlot[id].ready() ? 0 : 1;
+				}
+				mSlotBusy->set(busy);
+				mPeak = std::max(mPeak, busy);
+			} else {
+				mFramesDropped->add();
 			}
 			break;
 		case Result::again:
@@ -98,32 +236,142 @@ void Dummy::task() {
 		case Result::eof:
 			if (mLive) {
 				stop();
-				std::this_thread::sleep_for(std::chrono::milliseconds(3000));
-				if (!start()) {
-					deactivate();
-				}
+				schedule();
 			} else {
 				deactivate();
 			}
 			break;
 		case Result::changed:
 			stop();
-			std::this_thread::sleep_for(std::chrono::milliseconds(3000));
-			if (!start()) {
-				deactivate();
-			}
+			schedule();
 			break;
 		case Result::unsupported:
 			// It can be audio
 			break;
 		case Result::error:
-			// Nothing for now
+			// A run of errors means the connection is gone, a file would only restart from its beginning
+			if (++mErrors >= mRetryErrors) {
+				LOG(WARNING) << mName << ": Errors in a row = " << mErrors;
+				if (mLive) {
+					stop();
+					schedule();
+				} else {
+					deactivate();
+				}
+			}
 			break;
 	}
 }
 
+bool Dummy::recover() {
+	// Live sources may come up later, files will not
+	if (!mLive) {
+		return false;
+	}
+	stop();
+	schedule();
+	return active();
+}
+
+void Dummy::schedule() {
+	auto now = std::chrono::steady_clock::now();
+	if (!mRetrying) {
+		mRetrying = true;
+		mRetry = 0;
+		mRetrySince = now;
+		mBackoff = mRetryDelay;
+	}
+	if ((mRetryAttempts > 0 && mRetry >= mRetryAttempts) ||
+	    (mRetryDuration.count() > 0 && now - mRetrySince >= mRetryDuration)) {
+		LOG(ERROR) << mName << ": Giving up after reconnect attempts = " << mRetry;
+		mRetrying = false;
+		deactivate();
+		return;
+	}
+
+	// Jitter spreads out streams that lost their source at the same moment
+	std::uniform_real_distribution<double> spread(1.0 - mRetryJitter, 1.0 + mRetryJitter);
+	auto delay = std::chrono::milliseconds((int64_t)(mBackoff.count() * spread(mRandom)));
+	mRetryAt = now + delay;
+	mBackoff = std::min(std::chrono::milliseconds((int64_t)(mBackoff.count() * mRetryFactor)), mRetryMaxDelay);
+	LOG(WARNING) << mName << ": Reconnect in " << delay.count() << " ms";
+}
+
+void Dummy::reconnect() {
+	auto now = std::chrono::steady_clock::now();
+	if (now < mRetryAt) {
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(mRetryAt - now,
+		                                                                          std::chrono::milliseconds(100)));
+		return;
+	}
+
+	++mRetry;
+	mReconnects->add();
+	if (start()) {
+		LOG(INFO) << mName << ": Reconnected after attempts = " << mRetry;
+		mRetrying = false;
+		mErrors = 0;
+		return;
+	}
+	stop();
+	schedule();
+}
+
+Slot* Dummy::take() {
+	for (size_t step = 0; step < mActive; ++step) {
+		size_t id = mSlotId + step < mActive ? mSlotId + step : mSlotId + step - mActive;
+		if (mSlot[id].ready()) {
+			mSlotId = id;
+			return &mSlot[id];
+		}
+	}
+
+	// Every slot is in flight, take one more instead of dropping or blocking
+	if (mActive < mSlot.size()) {
+		mSlotId = mActive++;
+		mSlotActive->set(mActive);
+		mPeak = mActive;
+		mWindow = std::chrono::steady_clock::now();
+		LOG(INFO) << mName << ": Ring grown to " << mActive << " slots";
+		return &mSlot[mSlotId];
+	}
+	return nullptr;
+}
+
+void Dummy::resize() {
+	auto now = std::chrono::steady_clock::now();
+	if (now - mWindow < std::chrono::seconds(10)) {
+		return;
+	}
+
+	// A window where the ring never filled up gives back its last slot
+	if (mActive > mMin && mPeak + 1 < mActive && mSlot[mActive - 1].ready()) {
+		mSlot[mActive - 1].release();
+		--mActive;
+		if (mSlotId >= mActive) {
+			mSlotId = 0;
+		}
+		mSlotActive->set(mActive);
+		LOG(INFO) << mName << ": Ring shrunk to " << mActive << " slots";
+	}
+
+	size_t bytes = 0;
+	for (auto& s : mSlot) {
+		bytes += s.memory();
+	}
+	mSlotBytes->set(bytes);
+	mNodeBytes->add((int64_t)bytes - mNodeReported);
+	mNodeReported = bytes;
+	mPeak = 0;
+	mWindow = now;
+}
+
 Dummy::Result Dummy::read([[maybe_unused]]AVFrame* frame) {
 	return Result::eof;
 }
 
+AVRational Dummy::timeBase() const {
+	return AV_TIME_BASE_Q;
+}
+
 }
@@ -2,6 +2,8 @@
 
 #include "module.h"
 
+#include <random>
+
 #include "queue.h"
 #include "slot.h"
 
@@ -13,7 +15,7 @@ public:
 	Dummy(const json& config,
 	      size_t id,
 	      std::vector<Slot>& slot,
-	      std::vector<Queue<uint32_t>>& queue,
+	      std::vector<Queue<Handle>>& queue,
 	      std::vector<size_t>& queueId);
 	Dummy(const Dummy& other) = delete;
 	Dummy(Dummy&& other) noexcept;
@@ -32,17 +34,58 @@ protected:
 	};
 
 	void task() override;
+	bool recover() override;
 	virtual Result read(AVFrame* frame);
+	virtual AVRational timeBase() const;
 
 	bool mLive = true;
 
 private:
 	std::vector<Slot>& mSlot;
-	std::vector<Queue<uint32_t>>& mQueue;
+	std::vector<Queue<Handle>>& mQueue;
 	std::vector<size_t> mQueueId;
 
 	AVFrame* mFrame = NULL;
-	uint8_t mSlotId = 0;
+	uint16_t mSlotId = 0;
+
+	// Ring uses the first mActive slots, growing up to the whole vector under backpressure
+	Slot* take();
+	void resize();
+
+	size_t mMin = 0;
+	size_t mActive = 0;
+	size_t mPeak = 0;
+	std::chrono::steady_clock::time_point mWindow;
+
+	// Reconnect supervisor, waits in short steps from task so terminate is never held up
+	void schedule();
+	void reconnect();
+
+	std::chrono::milliseconds mRetryDelay = std::chrono::milliseconds(1000);
+	std::chrono::milliseconds mRetryMaxDelay = std::chrono::milliseconds(30000);
+	double mRetryFactor = 2.0;
+	double mRetryJitter = 0.5;
+	size_t mRetryAttempts = 0;
+	std::chrono::milliseconds mRetryDuration = std::chrono::milliseconds(0);
+	size_t mRetryErrors = 25;
+
+	bool mRetrying = false;
+	size_t mRetry = 0;
+	size_t mErrors = 0;
+	std::chrono::milliseconds mBackoff = std::chrono::milliseconds(0);
+	std::chrono::steady_clock::time_point mRetryAt;
+	std::chrono::steady_clock::time_point mRetrySince;
+	std::minstd_rand mRandom;
+
+	Metrics::Histogram* mDecodeTime = nullptr;
+	Metrics::Gauge* mSlotBusy = nullptr;
+	Metrics::Gauge* mSlotActive = nullptr;
+	Metrics::Gauge* mSlotBytes = nullptr;
+	Metrics::Counter* mReconnects = nullptr;
+
+	// Share of the ring in the per node total, the gauge is summed over streams
+	Metrics::Gauge* mNodeBytes = nullptr;
+	int64_t mNodeReported = 0;
 
 };
 
@@ -0,0 +1,167 @@
+#include "file.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+namespace Sight::Input {
+
+File::File(const json& config,
+           size_t id,
+           std::vector<Slot>& slot,
+           std::vector<Queue<Handle>>& queue,
+           std::vector<size_t>& queueId) :
+	Stream(config, id, slot, queue, queueId) {
+	mPath = config["url"];
+}
+
+File::File(File&& other) noexcept :
+	Stream(std::move(other)),
+	mPath(std::move(other.mPath)),
+	mFd(std::exchange(other.mFd, -1)),
+	mData(std::exchange(other.mData, nullptr)),
+	mSize(std::exchange(other.mSize, 0)),
+	mPosition(std::exchange(other.mPosition, 0)),
+	mReleased(std::exchange(other.mReleased, 0)),
+	mIo(std::exchange(other.mIo, nullptr)) {
+}
+
+File::~File() {
+	unmap();
+}
+
+bool File::validate(const json& config) {
+	if (!Stream::validate(config)) {
+		return false;
+	}
+	std::string url = config["url"];
+	if (url.find("://") != std::string::npos) {
+		LOG(ERROR) << "Url is not a local file path";
+		return false;
+	}
+	return true;
+}
+
+void File::stop() {
+	Stream::stop();
+	unmap();
+}
+
+bool File::prepare() {
+	unmap();
+
+	mFd = open(mPath.c_str(), O_RDONLY);
+	if (mFd < 0) {
+		LOG(ERROR) << mName << ": Could not open file " << mPath << ", error = " << std::strerror(errno);
+		return false;
+	}
+	struct stat st;
+	if (fstat(mFd, &st) < 0 || st.st_size == 0) {
+		LOG(ERROR) << mName << ": File " << mPath << " is empty or not readable";
+		return false;
+	}
+	mSize = st.st_size;
+
+	void* data = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, mFd, 0);
+	if (data == MAP_FAILED) {
+		LOG(ERROR) << mName << ": Could not map file " << mPath << ", error = " << std::strerror(errno);
+		return false;
+	}
+	mData = (uint8_t*)data;
+	madvise(mData, mSize, MADV_SEQUENTIAL);
+	posix_fadvise(mFd, 0, mSize, POSIX_FADV_SEQUENTIAL);
+
+	// AVIOContext owns its buffer and may replace it, it is freed with av_freep
+	uint8_t* buffer = (uint8_t*)av_malloc(kBufferSize);
+	if (!buffer) {
+		LOG(ERROR) << mName << ": Failed to allocate memory for AVIOContext buffer";
+		return false;
+	}
+	mIo = avio_alloc_context(buffer, kBufferSize, 0, this, readPacket, NULL, seekPacket);
+	if (!mIo) {
+		av_free(buffer);
+		LOG(ERROR) << mName << ": Failed to allocate memory for AVIOContext";
+		return false;
+	}
+	mFormatContext->pb = mIo;
+	mFormatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+	return true;
+}
+
+int File::readPacket(void* opaque, uint8_t* buffer, int size) {
+	File* file = (File*)opaque;
+	if (file->mPosition >= file->mSize) {
+		return AVERROR_EOF;
+	}
+	size_t count = std::min((size_t)size, file->mSize - file->mPosition);
+	std::memcpy(buffer, file->mData + file->mPosition, count);
+	file->mPosition += count;
+	file->release();
+	return count;
+}
+
+int64_t File::seekPacket(void* opaque, int64_t offset, int whence) {
+	File* file = (File*)opaque;
+	int64_t position = 0;
+	switch (whence & ~AVSEEK_FORCE) {
+		case AVSEEK_SIZE:
+			return file->mSize;
+		case SEEK_SET:
+			position = offset;
+			break;
+		case SEEK_CUR:
+			position = file->mPosition + offset;
+			break;
+		case SEEK_END:
+			position = file->mSize + offset;
+			break;
+		default:
+			return AVERROR(EINVAL);
+	}
+	if (position < 0 || (size_t)position > file->mSize) {
+		return AVERROR(EINVAL);
+	}
+	file->mPosition = position;
+	return position;
+}
+
+void File::release() {
+	if (mPosition < mReleased + 2 * kWindow) {
+		return;
+	}
+
+	// Containers seek back a little for index and interleaving, a window stays mapped
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t end = (mPosition - kWindow) / page * page;
+	if (end <= mReleased) {
+		return;
+	}
+	madvise(mData + mReleased, end - mReleased, MADV_DONTNEED);
+	posix_fadvise(mFd, mReleased, end - mReleased, POSIX_FADV_DONTNEED);
+	mReleased = end;
+}
+
+void File::unmap() {
+	if (mIo) {
+		av_freep(&mIo->buffer);
+		avio_context_free(&mIo);
+	}
+	if (mData) {
+		munmap(mData, mSize);
+		mData = NULL;
+	}
+	if (mFd >= 0) {
+		close(mFd);
+		mFd = -1;
+	}
+	mSize = 0;
+	mPosition = 0;
+	mReleased = 0;
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "stream.h"
+
+namespace Sight::Input {
+
+// Local container read through a memory mapping instead of the file protocol
+class File
+	: public Stream {
+public:
+	File(const json& config,
+	     size_t id,
+	     std::vector<Slot>& slot,
+	     std::vector<Queue<Handle>>& queue,
+	     std::vector<size_t>& queueId);
+	File(const File& other) = delete;
+	File(File&& other) noexcept;
+	~File();
+
+	static bool validate(const json& config);
+
+protected:
+	void stop() override;
+	bool prepare() override;
+
+private:
+	static int readPacket(void* opaque, uint8_t* buffer, int size);
+	static int64_t seekPacket(void* opaque, int64_t offset, int whence);
+
+	// Pages this far behind the read position are handed back to the kernel
+	static constexpr size_t kWindow = 16 * 1024 * 1024;
+	static constexpr int kBufferSize = 256 * 1024;
+
+	void release();
+	void unmap();
+
+	std::string mPath = "";
+	int mFd = -1;
+	uint8_t* mData = NULL;
+	size_t mSize = 0;
+	size_t mPosition = 0;
+	size_t mReleased = 0;
+	AVIOContext* mIo = NULL;
+
+};
+
+}
@@ -0,0 +1,242 @@
+#include "images.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include <glog/logging.h>
+
+namespace Sight::Input {
+
+Images::Images(const json& config,
+               size_t id,
+               std::vector<Slot>& slot,
+               std::vector<Queue<Handle>>& queue,
+               std::vector<size_t>& queueId) :
+	Dummy(config, id, slot, queue, queueId) {
+	mPath = config["path"];
+	mThreads = std::max(1u, std::thread::hardware_concurrency() / 2);
+	if (config.contains("threads")) {
+		mThreads = config["threads"];
+	}
+	mPrefetch = mThreads * 2;
+	if (config.contains("prefetch")) {
+		mPrefetch = config["prefetch"];
+	}
+	if (config.contains("fps")) {
+		mFps = config["fps"];
+	}
+}
+
+Images::Images(Images&& other) noexcept :
+	Dummy(std::move(other)),
+	mPath(std::move(other.mPath)),
+	mThreads(std::exchange(other.mThreads, 0)),
+	mPrefetch(std::exchange(other.mPrefetch, 0)),
+	mFps(std::exchange(other.mFps, 0.0)) {
+}
+
+Images::~Images() {
+	stop();
+}
+
+bool Images::validate(const json& config) {
+	if (!Dummy::validate(config)) {
+		return false;
+	}
+	if (!config.contains("path") || !config["path"].is_string() || config["path"].empty()) {
+		LOG(ERROR) << "Path is not exists, not string or empty";
+		return false;
+	}
+	for (auto& key : {"threads", "prefetch"}) {
+		if (config.contains(key) && (!config[key].is_number_unsigned() || config[key] == 0)) {
+			LOG(ERROR) << "Images " << key << " is not positive number";
+			return false;
+		}
+	}
+	if (config.contains("fps") && (!config["fps"].is_number() || config["fps"] < 0)) {
+		LOG(ERROR) << "Fps is not a non negative number";
+		return false;
+	}
+	return true;
+}
+
+bool Images::start() {
+	stop();
+
+	std::error_code error;
+	mFiles.clear();
+	for (auto& entry : std::filesystem::directory_iterator(mPath, error)) {
+		std::string extension = entry.path().extension();
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (entry.is_regular_file() && (extension == ".jpg" || extension == ".jpeg" || extension == ".png")) {
+			mFiles.push_back(entry.path());
+		}
+	}
+	if (error) {
+		LOG(ERROR) << mName << ": Could not list directory " << mPath << ", error = " << error.message();
+		return false;
+	}
+	if (mFiles.empty()) {
+		LOG(ERROR) << mName << ": No JPEG or PNG files in " << mPath;
+		return false;
+	}
+	std::sort(mFiles.begin(), mFiles.end());
+
+	mTaken = 0;
+	mNext = 0;
+	mNumber = 0;
+	mBegin = std::chrono::steady_clock::now();
+	mDecoding = true;
+	for (size_t id = 0; id < std::min(mThreads, mFiles.size()); ++id) {
+		mWorker.push_back(std::thread(&Images::worker, this));
+	}
+
+	LOG(INFO) << mName << ": Images: " << mFiles.size() << ", decode threads: " << mWorker.size();
+	return true;
+}
+
+void Images::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mDecoding = false;
+	}
+	mSpace.notify_all();
+	for (auto& worker : mWorker) {
+		worker.join();
+	}
+	mWorker.clear();
+
+	for (auto& [index, frame] : mDecoded) {
+		av_frame_free(&frame);
+	}
+	mDecoded.clear();
+}
+
+Dummy::Result Images::read(AVFrame* frame) {
+	if (mNext >= mFiles.size()) {
+		return Result::eof;
+	}
+
+	std::unique_lock<std::mutex> lock(mLock);
+	if (!mReady.wait_for(lock, std::chrono::milliseconds(100), [this] { return mDecoded.contains(mNext); })) {
+		return Result::again;
+	}
+	AVFrame* decoded = mDecoded[mNext];
+	mDecoded.erase(mNext);
+	++mNext;
+	lock.unlock();
+	mSpace.notify_all();
+
+	if (!decoded) {
+		// Unreadable file, already logged by the worker
+		mFramesDropped->add();
+		return Result::again;
+	}
+
+	// Pace to the configured rate, zero means as fast as slots are free
+	if (mFps > 0.0) {
+		auto due = mBegin + std::chrono::microseconds((int64_t)(mNumber * 1000000.0 / mFps));
+		std::this_thread::sleep_until(due);
+	}
+
+	av_frame_unref(frame);
+	av_frame_move_ref(frame, decoded);
+	av_frame_free(&decoded);
+	frame->pts = mNumber;
+	frame->pkt_dts = mNumber;
+	frame->coded_picture_number = ++mNumber;
+	return Result::success;
+}
+
+AVRational Images::timeBase() const {
+	// Frame number is the timestamp
+	double rate = mFps > 0.0 ? mFps : 25.0;
+	return {1000, (int)(rate * 1000.0)};
+}
+
+void Images::worker() {
+	pthread_setname_np(pthread_self(), (mName + ":decode").substr(0, 15).c_str());
+	mThread.apply(mName + ":decode");
+	std::map<AVCodecID, AVCodecContext*> context;
+	AVPacket* packet = av_packet_alloc();
+
+	while (packet) {
+		size_t index = 0;
+		{
+			// Stay at most prefetch files ahead of the reader
+			std::unique_lock<std::mutex> lock(mLock);
+			mSpace.wait(lock, [this] {
+				return !mDecoding || mTaken >= mFiles.size() || mTaken < mNext + mPrefetch;
+			});
+			if (!mDecoding || mTaken >= mFiles.size()) {
+				break;
+			}
+			index = mTaken++;
+		}
+
+		AVFrame* frame = decode(mFiles[index], context, packet);
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mDecoded[index] = frame;
+		}
+		mReady.notify_all();
+	}
+
+	for (auto& [id, c] : context) {
+		avcodec_free_context(&c);
+	}
+	av_packet_free(&packet);
+}
+
+AVFrame* Images::decode(const std::string& path, std::map<AVCodecID, AVCodecContext*>& context, AVPacket* packet) {
+	std::string extension = std::filesystem::path(path).extension();
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	AVCodecID codecId = extension == ".png" ? AV_CODEC_ID_PNG : AV_CODEC_ID_MJPEG;
+
+	if (!context.contains(codecId)) {
+		AVCodec* codec = avcodec_find_decoder(codecId);
+		AVCodecContext* c = codec ? avcodec_alloc_context3(codec) : NULL;
+		if (!c || avcodec_open2(c, codec, NULL) < 0) {
+			avcodec_free_context(&c);
+			LOG(ERROR) << mName << ": Could not open decoder for " << extension;
+			return nullptr;
+		}
+		context[codecId] = c;
+	}
+	AVCodecContext* c = context[codecId];
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	std::streamsize size = file.tellg();
+	if (!file.is_open() || size <= 0 || av_new_packet(packet, size) < 0) {
+		LOG(ERROR) << mName << ": Could not read " << path;
+		return nullptr;
+	}
+	file.seekg(0);
+	file.read((char*)packet->data, size);
+	if (file.fail()) {
+		av_packet_unref(packet);
+		LOG(ERROR) << mName << ": Could not read " << path;
+		return nullptr;
+	}
+
+	AVFrame* frame = av_frame_alloc();
+	int response = frame ? avcodec_send_packet(c, packet) : AVERROR(ENOMEM);
+	av_packet_unref(packet);
+	if (response >= 0) {
+		response = avcodec_receive_frame(c, frame);
+	}
+	if (response < 0) {
+		LOG(ERROR) << mName
+		           << ": Could not decode " << path << ", error = " << response
+		           << ", text = " << std::string(av_err2str(response));
+		av_frame_free(&frame);
+		// Decoder state is unknown after a failure, start over on the next file
+		avcodec_free_context(&context[codecId]);
+		context.erase(codecId);
+		return nullptr;
+	}
+	return frame;
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "dummy.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+namespace Sight::Input {
+
+// Directory of JPEG and PNG files in name order, decoded ahead on a pool of threads
+class Images
+	: public Dummy {
+public:
+	Images(const json& config,
+	       size_t id,
+	       std::vector<Slot>& slot,
+	       std::vector<Queue<Handle>>& queue,
+	       std::vector<size_t>& queueId);
+	Images(const Images& other) = delete;
+	Images(Images&& other) noexcept;
+	~Images();
+
+	static bool validate(const json& config);
+
+protected:
+	bool start() override;
+	void stop() override;
+	Result read(AVFrame* frame) override;
+	AVRational timeBase() const override;
+
+private:
+	void worker();
+	AVFrame* decode(const std::string& path, std::map<AVCodecID, AVCodecContext*>& context, AVPacket* packet);
+
+	std::string mPath = "";
+	size_t mThreads = 4;
+	size_t mPrefetch = 0;
+	double mFps = 0.0;
+
+	std::vector<std::string> mFiles;
+	std::vector<std::thread> mWorker;
+	std::atomic_bool mDecoding = false;
+
+	// Decoded frames by file index, read takes them in order
+	std::mutex mLock;
+	std::condition_variable mReady;
+	std::condition_variable mSpace;
+	std::map<size_t, AVFrame*> mDecoded;
+	size_t mTaken = 0;
+	size_t mNext = 0;
+
+	int64_t mNumber = 0;
+	std::chrono::steady_clock::time_point mBegin;
+
+};
+
+}
@@ -0,0 +1,221 @@
+#include "raw.h"
+
+#include <cstring>
+
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include "arena.h"
+
+namespace Sight::Input {
+
+Raw::Raw(const json& config,
+         size_t id,
+         std::vector<Slot>& slot,
+         std::vector<Queue<Handle>>& queue,
+         std::vector<size_t>& queueId) :
+	Dummy(config, id, slot, queue, queueId) {
+	mUrl = config["url"];
+	if (config.contains("format") && config["format"] != "y4m") {
+		mY4m = false;
+		std::string format = config["format"];
+		mFormat = av_get_pix_fmt(format.c_str());
+		mWidth = config["width"];
+		mHeight = config["height"];
+	}
+	if (config.contains("fps")) {
+		mRate = av_d2q(config["fps"].get<double>(), 1000000);
+	}
+}
+
+Raw::Raw(Raw&& other) noexcept :
+	Dummy(std::move(other)),
+	mUrl(std::move(other.mUrl)),
+	mY4m(other.mY4m),
+	mWidth(std::exchange(other.mWidth, 0)),
+	mHeight(std::exchange(other.mHeight, 0)),
+	mFormat(std::exchange(other.mFormat, AV_PIX_FMT_NONE)),
+	mRate(other.mRate),
+	mFile(std::exchange(other.mFile, nullptr)),
+	mNumber(std::exchange(other.mNumber, 0)) {
+}
+
+Raw::~Raw() {
+	stop();
+}
+
+bool Raw::validate(const json& config) {
+	if (!Dummy::validate(config)) {
+		return false;
+	}
+	if (!config.contains("url") || !config["url"].is_string() || config["url"].empty()) {
+		LOG(ERROR) << "Url is not exists, not string or empty";
+		return false;
+	}
+	if (config.contains("format") && config["format"] != "y4m") {
+		if (!config["format"].is_string()) {
+			LOG(ERROR) << "Format is not string";
+			return false;
+		}
+		std::string format = config["format"];
+		AVPixelFormat pixFormat = av_get_pix_fmt(format.c_str());
+		const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixFormat);
+		if (pixFormat == AV_PIX_FMT_NONE || !desc ||
+		    (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL))) {
+			LOG(ERROR) << "Unsupported pixel format = " << format;
+			return false;
+		}
+		if (!config.contains("width") || !config["width"].is_number_unsigned() || config["width"] == 0 ||
+		    !config.contains("height") || !config["height"].is_number_unsigned() || config["height"] == 0) {
+			LOG(ERROR) << "Width or height is not exists or not positive number";
+			return false;
+		}
+	}
+	if (config.contains("fps") && (!config["fps"].is_number() || config["fps"] <= 0)) {
+		LOG(ERROR) << "Fps is not a positive number";
+		return false;
+	}
+	return true;
+}
+
+bool Raw::start() {
+	stop();
+	mFile = mUrl == "-" ? fdopen(dup(fileno(stdin)), "rb") : fopen(mUrl.c_str(), "rb");
+	if (!mFile) {
+		LOG(ERROR) << mName << ": Could not open " << mUrl << ", error = " << std::strerror(errno);
+		return false;
+	}
+	// Planes are read straight into slot frames, a large buffer keeps pipes from trickling
+	setvbuf(mFile, NULL, _IOFBF, 1024 * 1024);
+
+	if (mY4m && !header()) {
+		return false;
+	}
+	mNumber = 0;
+
+	LOG(INFO) << mName
+	          << ": Raw frame size: " << mWidth << "x" << mHeight
+	          << ", pixel format: " << av_get_pix_fmt_name(mFormat)
+	          << ", rate: " << mRate.num << "/" << mRate.den;
+	return true;
+}
+
+void Raw::stop() {
+	if (mFile) {
+		fclose(mFile);
+		mFile = NULL;
+	}
+}
+
+bool Raw::header() {
+	char line[256];
+	if (!fgets(line, sizeof(line), mFile) || std::strncmp(line, "YUV4MPEG2 ", 10) != 0) {
+		LOG(ERROR) << mName << ": Not a YUV4MPEG2 stream";
+		return false;
+	}
+
+	mFormat = AV_PIX_FMT_YUV420P;
+	for (char* token = std::strtok(line + 10, " \n"); token; token = std::strtok(NULL, " \n")) {
+		switch (token[0]) {
+			case 'W':
+				mWidth = std::atoi(token + 1);
+				break;
+			case 'H':
+				mHeight = std::atoi(token + 1);
+				break;
+			case 'F': {
+				int num = 0;
+				int den = 0;
+				if (std::sscanf(token + 1, "%d:%d", &num, &den) == 2 && num > 0 && den > 0) {
+					mRate = {num, den};
+				}
+				break;
+			}
+			case 'C': {
+				std::string colorspace = token + 1;
+				if (colorspace.starts_with("420")) {
+					mFormat = colorspace == "420p10" ? AV_PIX_FMT_YUV420P10LE : AV_PIX_FMT_YUV420P;
+				} else if (colorspace == "422") {
+					mFormat = AV_PIX_FMT_YUV422P;
+				} else if (colorspace == "444") {
+					mFormat = AV_PIX_FMT_YUV444P;
+				} else if (colorspace == "mono") {
+					mFormat = AV_PIX_FMT_GRAY8;
+				} else {
+					LOG(ERROR) << mName << ": Unsupported YUV4MPEG2 colorspace = " << colorspace;
+					return false;
+				}
+				break;
+			}
+			default:
+				// Interlacing, aspect and extensions do not change the layout
+				break;
+		}
+	}
+	if (mWidth <= 0 || mHeight <= 0) {
+		LOG(ERROR) << mName << ": YUV4MPEG2 header has no frame size";
+		return false;
+	}
+	return true;
+}
+
+Dummy::Result Raw::read(AVFrame* frame) {
+	if (mY4m) {
+		// Every frame starts with its own header line, parameters are not used
+		int c = fgetc(mFile);
+		if (c == EOF) {
+			return Result::eof;
+		}
+		ungetc(c, mFile);
+		char line[256];
+		if (!fgets(line, sizeof(line), mFile) || std::strncmp(line, "FRAME", 5) != 0) {
+			LOG(ERROR) << mName << ": Frame header is missing";
+			return Result::error;
+		}
+	}
+
+	if (frame->width != mWidth || frame->height != mHeight || frame->format != mFormat || !frame->buf[0] ||
+	    !av_buffer_is_writable(frame->buf[0])) {
+		av_frame_unref(frame);
+		frame->width = mWidth;
+		frame->height = mHeight;
+		frame->format = mFormat;
+		if (!Arena::allocate(frame)) {
+			LOG(ERROR) << mName << ": Failed to allocate frame buffer";
+			return Result::error;
+		}
+	}
+
+	// Rows are packed in the stream, slot frames may be padded
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(mFormat);
+	for (int plane = 0; plane < 4 && frame->data[plane]; ++plane) {
+		bool chroma = plane == 1 || plane == 2;
+		int rows = chroma ? -((-mHeight) >> desc->log2_chroma_h) : mHeight;
+		int bytes = av_image_get_linesize(mFormat, mWidth, plane);
+		bool packed = frame->linesize[plane] == bytes;
+		for (int y = 0; y < (packed ? 1 : rows); ++y) {
+			size_t size = packed ? (size_t)bytes * rows : bytes;
+			if (fread(frame->data[plane] + y * frame->linesize[plane], 1, size, mFile) != size) {
+				if (feof(mFile)) {
+					LOG(WARNING) << mName << ": Stream ended inside a frame";
+					return Result::eof;
+				}
+				LOG(ERROR) << mName << ": Could not read frame, error = " << std::strerror(errno);
+				return Result::error;
+			}
+		}
+	}
+
+	frame->pts = mNumber;
+	frame->pkt_dts = mNumber;
+	frame->coded_picture_number = ++mNumber;
+	return Result::success;
+}
+
+AVRational Raw::timeBase() const {
+	// Frame number is the timestamp
+	return av_inv_q(mRate);
+}
+
+}
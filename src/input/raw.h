@@ -0,0 +1,45 @@
+#pragma once
+
+#include "dummy.h"
+
+#include <cstdio>
+
+namespace Sight::Input {
+
+// Uncompressed frames from a file or a pipe, either YUV4MPEG2 or headerless planes
+class Raw
+	: public Dummy {
+public:
+	Raw(const json& config,
+	    size_t id,
+	    std::vector<Slot>& slot,
+	    std::vector<Queue<Handle>>& queue,
+	    std::vector<size_t>& queueId);
+	Raw(const Raw& other) = delete;
+	Raw(Raw&& other) noexcept;
+	~Raw();
+
+	static bool validate(const json& config);
+
+protected:
+	bool start() override;
+	void stop() override;
+	Result read(AVFrame* frame) override;
+	AVRational timeBase() const override;
+
+private:
+	bool header();
+
+	std::string mUrl = "";
+	bool mY4m = true;
+	int mWidth = 0;
+	int mHeight = 0;
+	AVPixelFormat mFormat = AV_PIX_FMT_YUV420P;
+	AVRational mRate = {25, 1};
+
+	FILE* mFile = NULL;
+	int64_t mNumber = 0;
+
+};
+
+}
@@ -0,0 +1,107 @@
+#include "replay.h"
+
+#include <glog/logging.h>
+
+namespace Sight::Input {
+
+Replay::Replay(const json& config,
+               size_t id,
+               std::vector<Slot>& slot,
+               std::vector<Queue<Handle>>& queue,
+               std::vector<size_t>& queueId) :
+	Stream(config, id, slot, queue, queueId) {
+	if (config.contains("loop")) {
+		mLoop = config["loop"];
+	}
+	if (config.contains("realtime")) {
+		mRealtime = config["realtime"];
+	}
+}
+
+Replay::Replay(Replay&& other) noexcept :
+	Stream(std::move(other)),
+	mLoop(std::exchange(other.mLoop, false)),
+	mRealtime(std::exchange(other.mRealtime, false)),
+	mFirst(std::exchange(other.mFirst, AV_NOPTS_VALUE)),
+	mLast(std::exchange(other.mLast, 0)),
+	mOffset(std::exchange(other.mOffset, 0)),
+	mNumber(std::exchange(other.mNumber, 0)) {
+}
+
+Replay::~Replay() {
+}
+
+bool Replay::validate(const json& config) {
+	if (!Stream::validate(config)) {
+		return false;
+	}
+	if (config.contains("loop") && !config["loop"].is_boolean()) {
+		LOG(ERROR) << "Loop is not boolean";
+		return false;
+	}
+	if (config.contains("realtime") && !config["realtime"].is_boolean()) {
+		LOG(ERROR) << "Realtime is not boolean";
+		return false;
+	}
+	return true;
+}
+
+bool Replay::start() {
+	mBeginPts = AV_NOPTS_VALUE;
+	return Stream::start();
+}
+
+Dummy::Result Replay::read(AVFrame* frame) {
+	Result result = Stream::read(frame);
+	AVStream* stream = mFormatContext->streams[mVideoStream];
+
+	if (result == Result::eof && mLoop) {
+		// Rewind and continue timestamps one frame after the last one
+		if (av_seek_frame(mFormatContext, mVideoStream, stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0,
+		                  AVSEEK_FLAG_BACKWARD) < 0) {
+			LOG(ERROR) << mName << ": Could not rewind file";
+			return Result::eof;
+		}
+		avcodec_flush_buffers(mCodecContext);
+
+		int64_t duration = 1;
+		AVRational rate = stream->avg_frame_rate;
+		if (rate.num > 0 && rate.den > 0) {
+			duration = std::max<int64_t>(1, av_rescale_q(1, {rate.den, rate.num}, stream->time_base));
+		}
+		if (mFirst != AV_NOPTS_VALUE) {
+			mOffset = mLast + duration - mFirst;
+		}
+		return Result::again;
+	}
+
+	if (result != Result::success) {
+		return result;
+	}
+
+	if (frame->pts == AV_NOPTS_VALUE) {
+		frame->pts = frame->best_effort_timestamp;
+	}
+	if (mFirst == AV_NOPTS_VALUE) {
+		mFirst = frame->pts;
+	}
+	frame->pts += mOffset;
+	frame->pkt_dts = frame->pts;
+	frame->coded_picture_number = ++mNumber;
+	mLast = frame->pts;
+
+	// Hold the frame until its presentation time
+	if (mRealtime) {
+		auto now = std::chrono::steady_clock::now();
+		if (mBeginPts == AV_NOPTS_VALUE) {
+			mBegin = now;
+			mBeginPts = frame->pts;
+		}
+		int64_t usec = av_rescale_q(frame->pts - mBeginPts, stream->time_base, AV_TIME_BASE_Q);
+		std::this_thread::sleep_until(mBegin + std::chrono::microseconds(usec));
+	}
+
+	return Result::success;
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "stream.h"
+
+namespace Sight::Input {
+
+class Replay
+	: public Stream {
+public:
+	Replay(const json& config,
+	       size_t id,
+	       std::vector<Slot>& slot,
+	       std::vector<Queue<Handle>>& queue,
+	       std::vector<size_t>& queueId);
+	Replay(const Replay& other) = delete;
+	Replay(Replay&& other) noexcept;
+	~Replay();
+
+	static bool validate(const json& config);
+
+protected:
+	bool start() override;
+	Result read(AVFrame* frame) override;
+
+private:
+	bool mLoop = true;
+	bool mRealtime = true;
+
+	// Timestamps keep growing across passes, so slots and encoders see one long stream
+	int64_t mFirst = AV_NOPTS_VALUE;
+	int64_t mLast = 0;
+	int64_t mOffset = 0;
+	int mNumber = 0;
+
+	std::chrono::steady_clock::time_point mBegin;
+	int64_t mBeginPts = AV_NOPTS_VALUE;
+
+};
+
+}
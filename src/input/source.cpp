@@ -0,0 +1,116 @@
+#include "source.h"
+
+#include <utility>
+
+namespace Sight::Input {
+
+std::mutex Source::sLock;
+std::map<std::string, std::weak_ptr<Source>> Source::sSources;
+
+Source::~Source() {
+	for (auto& [owner, mailbox] : mMailbox) {
+		close(mailbox);
+	}
+}
+
+std::shared_ptr<Source> Source::attach(const std::string& key, const void* owner, bool& leader) {
+	std::lock_guard<std::mutex> registry(sLock);
+	auto source = sSources[key].lock();
+	if (!source) {
+		source = std::make_shared<Source>();
+		sSources[key] = source;
+	}
+
+	std::lock_guard<std::mutex> lock(source->mLock);
+	if (!source->mLeader) {
+		source->mLeader = owner;
+	}
+	leader = source->mLeader == owner;
+	if (!leader) {
+		source->mMailbox[owner] = Mailbox();
+	}
+	return source;
+}
+
+void Source::detach(const void* owner) {
+	std::unique_lock<std::mutex> lock(mLock);
+	if (mLeader == owner) {
+		// Followers reconnect on their own, the first one back decodes
+		mLeader = nullptr;
+		for (auto& [follower, mailbox] : mMailbox) {
+			close(mailbox);
+		}
+		mMailbox.clear();
+	} else {
+		auto it = mMailbox.find(owner);
+		if (it != mMailbox.end()) {
+			close(it->second);
+			mMailbox.erase(it);
+		}
+	}
+	lock.unlock();
+	mReady.notify_all();
+}
+
+void Source::publish(const AVFrame* frame, AVRational timeBase) {
+	std::unique_lock<std::mutex> lock(mLock);
+	mTimeBase = timeBase;
+	for (auto& [owner, mailbox] : mMailbox) {
+		if (mailbox.mFrames.size() >= kDepth) {
+			av_frame_free(&mailbox.mFrames.front());
+			mailbox.mFrames.pop_front();
+			++mailbox.mDropped;
+		}
+
+		// Reference only, the decoder never writes into a buffer that is still held
+		AVFrame* copy = av_frame_clone(frame);
+		if (copy) {
+			mailbox.mFrames.push_back(copy);
+		}
+	}
+	lock.unlock();
+	mReady.notify_all();
+}
+
+Source::Receive Source::receive(const void* owner, AVFrame* frame, std::chrono::milliseconds timeout, size_t& dropped) {
+	std::unique_lock<std::mutex> lock(mLock);
+	auto it = mMailbox.find(owner);
+	if (it == mMailbox.end()) {
+		return Receive::closed;
+	}
+	mReady.wait_for(lock, timeout, [&] {
+		auto found = mMailbox.find(owner);
+		return found == mMailbox.end() || !found->second.mFrames.empty();
+	});
+
+	it = mMailbox.find(owner);
+	if (it == mMailbox.end()) {
+		return Receive::closed;
+	}
+	auto& mailbox = it->second;
+	if (mailbox.mFrames.empty()) {
+		return Receive::empty;
+	}
+	dropped = std::exchange(mailbox.mDropped, 0);
+
+	AVFrame* next = mailbox.mFrames.front();
+	mailbox.mFrames.pop_front();
+	av_frame_unref(frame);
+	av_frame_move_ref(frame, next);
+	av_frame_free(&next);
+	return Receive::frame;
+}
+
+AVRational Source::timeBase() const {
+	std::lock_guard<std::mutex> lock(mLock);
+	return mTimeBase;
+}
+
+void Source::close(Mailbox& mailbox) {
+	for (auto& frame : mailbox.mFrames) {
+		av_frame_free(&frame);
+	}
+	mailbox.mFrames.clear();
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+extern "C" {
+#	include <libavutil/frame.h>
+}
+
+namespace Sight::Input {
+
+// One connection and decoder per url and options, shared by every stream input that asks for it.
+// The first input to attach is the leader and decodes, the others receive references to its frames.
+class Source {
+public:
+	enum class Receive {
+		frame,
+		empty,
+		closed
+	};
+
+	Source() = default;
+	Source(const Source& other) = delete;
+	~Source();
+
+	static std::shared_ptr<Source> attach(const std::string& key, const void* owner, bool& leader);
+	void detach(const void* owner);
+
+	void publish(const AVFrame* frame, AVRational timeBase);
+	Receive receive(const void* owner, AVFrame* frame, std::chrono::milliseconds timeout, size_t& dropped);
+	AVRational timeBase() const;
+
+private:
+	struct Mailbox {
+		std::deque<AVFrame*> mFrames;
+		size_t mDropped = 0;
+	};
+
+	// Followers hold at most this many frames, live streams prefer fresh ones
+	static constexpr size_t kDepth = 2;
+
+	static std::mutex sLock;
+	static std::map<std::string, std::weak_ptr<Source>> sSources;
+
+	mutable std::mutex mLock;
+	std::condition_variable mReady;
+	const void* mLeader = nullptr;
+	std::map<const void*, Mailbox> mMailbox;
+	AVRational mTimeBase = {1, 1000000};
+
+	void close(Mailbox& mailbox);
+
+};
+
+}
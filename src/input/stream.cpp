@@ -1,13 +1,18 @@
 #include "stream.h"
 
+#include <cstdio>
+#include <fstream>
+
 #include <glog/logging.h>
 
+#include "arena.h"
+
 namespace Sight::Input {
 
 Stream::Stream(const json& config,
                size_t id,
                std::vector<Slot>& slot,
-               std::vector<Queue<uint32_t>>& queue,
+               std::vector<Queue<Handle>>& queue,
                std::vector<size_t>& queueId) :
 	Dummy(config, id, slot, queue, queueId) {
 	mUrl = config["url"];
@@ -27,15 +32,53 @@ Stream::Stream(const json& config,
 			av_dict_set(&mOptions, el.key().c_str(), value.c_str(), 0);
 		}
 	}
+
+	if (config.contains("probe")) {
+		mProbeFile = config["probe"];
+		load();
+	}
+
+	// Files are read at the pace of each pipeline, only live streams are shared by default
+	mShared = config.value("shared", mLive && config["type"] == "stream");
+	mKey = mUrl + " " + config.value("options", json::object()).dump();
+
+	if (config.contains("segment")) {
+		mSegmentIndex = config["segment"]["index"];
+		mSegmentCount = config["segment"]["count"];
+	}
+	if (config.contains("pool")) {
+		mPool = config["pool"];
+	}
 }
 
 Stream::Stream(Stream&& other) noexcept :
 	Dummy(std::move(other)),
-	mUrl(std::move(other.mUrl)) {
+	mUrl(std::move(other.mUrl)),
+	mShared(std::exchange(other.mShared, false)),
+	mKey(std::move(other.mKey)),
+	mSource(std::move(other.mSource)),
+	mLeader(std::exchange(other.mLeader, false)),
+	mSegmentIndex(std::exchange(other.mSegmentIndex, 0)),
+	mSegmentCount(std::exchange(other.mSegmentCount, 1)),
+	mSegmentBegin(std::exchange(other.mSegmentBegin, AV_NOPTS_VALUE)),
+	mSegmentEnd(std::exchange(other.mSegmentEnd, AV_NOPTS_VALUE)),
+	mSegmentStarted(std::exchange(other.mSegmentStarted, true)),
+	mPool(other.mPool),
+	mBufferPool(std::exchange(other.mBufferPool, nullptr)),
+	mBufferSize(std::exchange(other.mBufferSize, 0)),
+	mProbeFile(std::move(other.mProbeFile)),
+	mProbe(std::exchange(other.mProbe, nullptr)),
+	mProbeStream(std::exchange(other.mProbeStream, -1)),
+	mRestored(std::exchange(other.mRestored, false)) {
 }
 
 Stream::~Stream() {
+	if (mSource) {
+		mSource->detach(this);
+	}
+	av_buffer_pool_uninit(&mBufferPool);
 	av_dict_free(&mOptions);
+	avcodec_parameters_free(&mProbe);
 }
 
 bool Stream::validate(const json& config) {
@@ -59,15 +102,38 @@ bool Stream::validate(const json& config) {
 			return false;
 		}
 	}
+	if (config.contains("probe") && (!config["probe"].is_string() || config["probe"].empty())) {
+		LOG(ERROR) << "Probe is not string or empty";
+		return false;
+	}
+	if (config.contains("shared") && !config["shared"].is_boolean()) {
+		LOG(ERROR) << "Shared is not boolean";
+		return false;
+	}
+	if (config.contains("pool") && !config["pool"].is_boolean()) {
+		LOG(ERROR) << "Pool is not boolean";
+		return false;
+	}
 	return true;
 }
 
 bool Stream::start() {
+	if (mShared) {
+		mSource = Source::attach(mKey, this, mLeader);
+		if (!mLeader) {
+			LOG(INFO) << mName << ": Following shared source " << mUrl;
+			return true;
+		}
+	}
+
 	mFormatContext = avformat_alloc_context();
 	if (!mFormatContext) {
 		LOG(ERROR) << mName << ": Could not allocate memory for Format Context";
 		return false;
 	}
+	if (!prepare()) {
+		return false;
+	}
 
 	int response = avformat_open_input(&mFormatContext, mUrl.c_str(), NULL, &mOptions);
 	if (response < 0) {
@@ -77,15 +143,18 @@ bool Stream::start() {
 		return false;
 	}
 
-	response = avformat_find_stream_info(mFormatContext, NULL);
-	if (response < 0) {
-		LOG(ERROR) << mName
-		           << ": Could not find stream info, error = " << response
-		           << ", text = " << std::string(av_err2str(response));
-		return false;
+	mRestored = restore();
+	if (!mRestored) {
+		response = avformat_find_stream_info(mFormatContext, NULL);
+		if (response < 0) {
+			LOG(ERROR) << mName
+			           << ": Could not find stream info, error = " << response
+			           << ", text = " << std::string(av_err2str(response));
+			return false;
+		}
 	}
 
-	for (size_t i = 0; i < mFormatContext->nb_streams; ++i) {
+	for (size_t i = 0; !mRestored && i < mFormatContext->nb_streams; ++i) {
 		AVCodecParameters* localCodecParameters = mFormatContext->streams[i]->codecpar;
 
 		// LOG(INFO) << "AVStream->time_base before open coded "
@@ -140,11 +209,23 @@ bool Stream::start() {
 		return false;
 	}
 
+	if (mPool && (mCodec->capabilities & AV_CODEC_CAP_DR1)) {
+		mCodecContext->opaque = this;
+		mCodecContext->get_buffer2 = buffer;
+	}
+
 	if (avcodec_open2(mCodecContext, mCodec, NULL) < 0) {
 		LOG(ERROR) << mName << ": Failed to open codec through avcodec_open2";
+		if (mRestored) {
+			forget();
+		}
 		return false;
 	}
 
+	if (!mRestored) {
+		remember();
+	}
+
 	LOG(INFO) << mName
 	          << ": Codec id: " << mCodecContext->codec_id
 	          << ", bit rate: " << mCodecContext->bit_rate
@@ -158,10 +239,20 @@ bool Stream::start() {
 		return false;
 	}
 
+	if (mSegmentCount > 1 && !segment()) {
+		return false;
+	}
+
 	return true;
 }
 
 void Stream::stop() {
+	if (mSource) {
+		mSource->detach(this);
+		mSource.reset();
+		mLeader = false;
+	}
+
 	if (mCodecContext) {
 		avcodec_send_packet(mCodecContext, NULL);
 	}
@@ -169,6 +260,12 @@ void Stream::stop() {
 	avformat_close_input(&mFormatContext);
 	avcodec_free_context(&mCodecContext);
 	av_packet_free(&mPacket);
+	{
+		// Frames still held by slots keep the pool alive until they are released
+		std::lock_guard<std::mutex> lock(mPoolLock);
+		av_buffer_pool_uninit(&mBufferPool);
+		mBufferSize = 0;
+	}
 
 	mCodec = NULL;
 	mCodecParameters = NULL;
@@ -176,6 +273,21 @@ void Stream::stop() {
 }
 
 Dummy::Result Stream::read(AVFrame* frame) {
+	if (mSource && !mLeader) {
+		size_t dropped = 0;
+		Source::Receive received = mSource->receive(this, frame, std::chrono::milliseconds(100), dropped);
+		mFramesDropped->add(dropped);
+		switch (received) {
+			case Source::Receive::frame:
+				return Result::success;
+			case Source::Receive::empty:
+				return Result::again;
+			case Source::Receive::closed:
+				// Leader is gone, reconnecting makes one of the followers the next leader
+				return Result::eof;
+		}
+	}
+
 	av_packet_unref(mPacket);
 
 	int response = av_read_frame(mFormatContext, mPacket);
@@ -199,6 +311,9 @@ Dummy::Result Stream::read(AVFrame* frame) {
 					return Result::eof;
 				} else if (response == AVERROR_INPUT_CHANGED) {
 					LOG(WARNING) << mName << ": Stream input changed";
+					if (mRestored) {
+						forget();
+					}
 					return Result::changed;
 				} else if (response == AVERROR(EAGAIN)) {
 					return Result::again;
@@ -227,7 +342,299 @@ Dummy::Result Stream::read(AVFrame* frame) {
 		return Result::error;
 	}
 
+	if (mSegmentCount > 1) {
+		int64_t pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+		if (frame->key_frame && mSegmentEnd != AV_NOPTS_VALUE && pts >= mSegmentEnd) {
+			// Next segment starts here
+			return Result::eof;
+		}
+		if (!mSegmentStarted) {
+			if (!frame->key_frame || pts < mSegmentBegin) {
+				return Result::again;
+			}
+			mSegmentStarted = true;
+		}
+	}
+
+	if (mSource) {
+		mSource->publish(frame, timeBase());
+	}
 	return Result::success;
 }
 
+bool Stream::segment() {
+	AVStream* stream = mFormatContext->streams[mVideoStream];
+	int64_t first = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+	int64_t duration = stream->duration;
+	if ((duration == AV_NOPTS_VALUE || duration <= 0) && mFormatContext->duration > 0) {
+		duration = av_rescale_q(mFormatContext->duration, AV_TIME_BASE_Q, stream->time_base);
+	}
+	if (duration == AV_NOPTS_VALUE || duration <= 0) {
+		LOG(ERROR) << mName << ": Unknown duration, file can not be split into segments";
+		return false;
+	}
+
+	mSegmentBegin = first + av_rescale(duration, mSegmentIndex, mSegmentCount);
+	mSegmentEnd = mSegmentIndex + 1 < mSegmentCount ?
+	              first + av_rescale(duration, mSegmentIndex + 1, mSegmentCount) : AV_NOPTS_VALUE;
+	mSegmentStarted = mSegmentIndex == 0;
+	if (mSegmentIndex > 0) {
+		// Land on the keyframe before begin, frames up to the first keyframe at begin belong to the previous segment
+		int response = av_seek_frame(mFormatContext, mVideoStream, mSegmentBegin, AVSEEK_FLAG_BACKWARD);
+		if (response < 0) {
+			LOG(ERROR) << mName
+			           << ": Could not seek to segment " << mSegmentIndex << ", error = " << response
+			           << ", text = " << std::string(av_err2str(response));
+			return false;
+		}
+	}
+
+	LOG(INFO) << mName << ": Segment " << mSegmentIndex + 1 << " of " << mSegmentCount
+	          << ", from " << mSegmentBegin << " to " << mSegmentEnd;
+	return true;
+}
+
+int Stream::buffer(AVCodecContext* context, AVFrame* frame, int flags) {
+	Stream* stream = (Stream*)context->opaque;
+	AVPixelFormat format = (AVPixelFormat)frame->format;
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+	if (context->codec_type != AVMEDIA_TYPE_VIDEO || !desc ||
+	    (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL))) {
+		return avcodec_default_get_buffer2(context, frame, flags);
+	}
+
+	// Padding the decoder may write past the picture, rows aligned for SIMD
+	int width = frame->width;
+	int height = frame->height;
+	int align[AV_NUM_DATA_POINTERS];
+	avcodec_align_dimensions2(context, &width, &height, align);
+	int linesize[4] = {0, 0, 0, 0};
+	if (av_image_fill_linesizes(linesize, format, width) < 0) {
+		return avcodec_default_get_buffer2(context, frame, flags);
+	}
+	for (auto& l : linesize) {
+		l = FFALIGN(l, Arena::kAlign);
+	}
+	uint8_t* data[4] = {NULL, NULL, NULL, NULL};
+	int size = av_image_fill_pointers(data, format, height, NULL, linesize);
+	if (size < 0) {
+		return avcodec_default_get_buffer2(context, frame, flags);
+	}
+
+	AVBufferRef* buffer = stream->pool(size + AV_INPUT_BUFFER_PADDING_SIZE);
+	if (!buffer) {
+		return AVERROR(ENOMEM);
+	}
+	av_image_fill_pointers(frame->data, format, height, buffer->data, linesize);
+	for (int plane = 0; plane < 4; ++plane) {
+		frame->linesize[plane] = linesize[plane];
+	}
+	frame->buf[0] = buffer;
+	frame->extended_data = frame->data;
+	return 0;
+}
+
+namespace {
+
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+AVBufferRef* allocate([[maybe_unused]]void* opaque, size_t size) {
+#else
+AVBufferRef* allocate([[maybe_unused]]void* opaque, int size) {
+#endif
+	return Arena::buffer(size);
+}
+
+}
+
+AVBufferRef* Stream::pool(size_t size) {
+	// Frame threads of the decoder ask concurrently, the pool itself is thread safe
+	std::lock_guard<std::mutex> lock(mPoolLock);
+	if (!mBufferPool || mBufferSize != size) {
+		av_buffer_pool_uninit(&mBufferPool);
+		mBufferPool = av_buffer_pool_init2(size, NULL, allocate, NULL);
+		mBufferSize = size;
+		LOG(INFO) << mName << ": Frame buffer pool of " << size << " bytes per frame";
+	}
+	return mBufferPool ? av_buffer_pool_get(mBufferPool) : NULL;
+}
+
+bool Stream::prepare() {
+	return true;
+}
+
+AVRational Stream::timeBase() const {
+	if (mSource && !mLeader) {
+		return mSource->timeBase();
+	}
+	if (mFormatContext && mVideoStream >= 0) {
+		return mFormatContext->streams[mVideoStream]->time_base;
+	}
+	return Dummy::timeBase();
+}
+
+
+bool Stream::restore() {
+	if (!mProbe || mProbeStream < 0 || (unsigned)mProbeStream >= mFormatContext->nb_streams) {
+		return false;
+	}
+
+	// Demuxer header must still agree with what was probed
+	AVStream* stream = mFormatContext->streams[mProbeStream];
+	if ((stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO && stream->codecpar->codec_type != AVMEDIA_TYPE_UNKNOWN) ||
+	    (stream->codecpar->codec_id != AV_CODEC_ID_NONE && stream->codecpar->codec_id != mProbe->codec_id)) {
+		LOG(WARNING) << mName << ": Stream differs from cached probe";
+		forget();
+		return false;
+	}
+
+	AVCodec* codec = avcodec_find_decoder(mProbe->codec_id);
+	if (!codec || avcodec_parameters_copy(stream->codecpar, mProbe) < 0) {
+		forget();
+		return false;
+	}
+
+	mVideoStream = mProbeStream;
+	mCodec = codec;
+	mCodecParameters = stream->codecpar;
+	LOG(INFO) << mName << ": Using cached probe, codec = " << codec->name;
+	return true;
+}
+
+void Stream::remember() {
+	if (!mProbe) {
+		mProbe = avcodec_parameters_alloc();
+	}
+	if (!mProbe || avcodec_parameters_copy(mProbe, mCodecParameters) < 0) {
+		avcodec_parameters_free(&mProbe);
+		return;
+	}
+	mProbeStream = mVideoStream;
+	save();
+}
+
+void Stream::forget() {
+	avcodec_parameters_free(&mProbe);
+	mProbeStream = -1;
+	if (!mProbeFile.empty()) {
+		std::remove(mProbeFile.c_str());
+	}
+}
+
+bool Stream::load() {
+	std::ifstream file(mProbeFile);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	json probe;
+	try {
+		probe = json::parse(file);
+	} catch (json::exception& e) {
+		LOG(WARNING) << mName << ": Cached probe is not readable, " << e.what();
+		return false;
+	}
+	if (!probe.is_object() || probe.value("url", "") != mUrl) {
+		return false;
+	}
+
+	try {
+		// Codec ids are not stable across libavcodec versions, names are
+		std::string codecName = probe["codec"];
+		const AVCodecDescriptor* descriptor = avcodec_descriptor_get_by_name(codecName.c_str());
+		if (!descriptor) {
+			return false;
+		}
+
+		mProbe = avcodec_parameters_alloc();
+		if (!mProbe) {
+			return false;
+		}
+		mProbe->codec_type = AVMEDIA_TYPE_VIDEO;
+		mProbe->codec_id = descriptor->id;
+		mProbe->width = probe["width"];
+		mProbe->height = probe["height"];
+		mProbe->format = av_get_pix_fmt(probe["format"].get<std::string>().c_str());
+		mProbe->profile = probe["profile"];
+		mProbe->level = probe["level"];
+		mProbe->bits_per_raw_sample = probe["bits_per_raw_sample"];
+		mProbe->field_order = probe["field_order"];
+		mProbe->color_range = probe["color_range"];
+		mProbe->color_primaries = probe["color_primaries"];
+		mProbe->color_trc = probe["color_trc"];
+		mProbe->color_space = probe["color_space"];
+		mProbe->chroma_location = probe["chroma_location"];
+		mProbe->sample_aspect_ratio = {probe["sample_aspect_ratio"][0], probe["sample_aspect_ratio"][1]};
+		mProbe->video_delay = probe["video_delay"];
+
+		std::string extradata = probe["extradata"];
+		if (!extradata.empty()) {
+			size_t size = extradata.size() / 2;
+			mProbe->extradata = (uint8_t*)av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+			if (!mProbe->extradata) {
+				avcodec_parameters_free(&mProbe);
+				return false;
+			}
+			for (size_t i = 0; i < size; ++i) {
+				mProbe->extradata[i] = std::stoi(extradata.substr(i * 2, 2), nullptr, 16);
+			}
+			mProbe->extradata_size = size;
+		}
+		mProbeStream = probe["stream"];
+	} catch (std::exception& e) {
+		LOG(WARNING) << mName << ": Cached probe is not valid, " << e.what();
+		avcodec_parameters_free(&mProbe);
+		mProbeStream = -1;
+		return false;
+	}
+
+	LOG(INFO) << mName << ": Loaded cached probe from " << mProbeFile;
+	return true;
+}
+
+void Stream::save() const {
+	if (mProbeFile.empty() || !mProbe) {
+		return;
+	}
+
+	static const char hex[] = "0123456789abcdef";
+	std::string extradata;
+	extradata.reserve(mProbe->extradata_size * 2);
+	for (int i = 0; i < mProbe->extradata_size; ++i) {
+		extradata.push_back(hex[mProbe->extradata[i] >> 4]);
+		extradata.push_back(hex[mProbe->extradata[i] & 0xf]);
+	}
+	const char* format = av_get_pix_fmt_name((AVPixelFormat)mProbe->format);
+
+	json probe = {
+		{"url", mUrl},
+		{"stream", mProbeStream},
+		{"codec", avcodec_get_name(mProbe->codec_id)},
+		{"width", mProbe->width},
+		{"height", mProbe->height},
+		{"format", format ? format : "none"},
+		{"profile", mProbe->profile},
+		{"level", mProbe->level},
+		{"bits_per_raw_sample", mProbe->bits_per_raw_sample},
+		{"field_order", mProbe->field_order},
+		{"color_range", mProbe->color_range},
+		{"color_primaries", mProbe->color_primaries},
+		{"color_trc", mProbe->color_trc},
+		{"color_space", mProbe->color_space},
+		{"chroma_location", mProbe->chroma_location},
+		{"sample_aspect_ratio", {mProbe->sample_aspect_ratio.num, mProbe->sample_aspect_ratio.den}},
+		{"video_delay", mProbe->video_delay},
+		{"extradata", extradata}
+	};
+
+	// Write aside and rename so a crash never leaves half a file
+	std::string temporary = mProbeFile + ".tmp";
+	std::ofstream file(temporary, std::ios::trunc);
+	file << probe.dump(4);
+	file.close();
+	if (file.fail() || std::rename(temporary.c_str(), mProbeFile.c_str()) != 0) {
+		LOG(WARNING) << mName << ": Could not save probe to " << mProbeFile;
+		std::remove(temporary.c_str());
+	}
+}
+
 }
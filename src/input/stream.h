@@ -1,6 +1,9 @@
 #pragma once
 
 #include "dummy.h"
+#include "source.h"
+
+#include <mutex>
 
 namespace Sight::Input {
 
@@ -10,7 +13,7 @@ public:
 	Stream(const json& config,
 	       size_t id,
 	       std::vector<Slot>& slot,
-	       std::vector<Queue<uint32_t>>& queue,
+	       std::vector<Queue<Handle>>& queue,
 	       std::vector<size_t>& queueId);
 	Stream(const Stream& other) = delete;
 	Stream(Stream&& other) noexcept;
@@ -22,8 +25,11 @@ protected:
 	bool start() override;
 	void stop() override;
 	Result read(AVFrame* frame) override;
+	AVRational timeBase() const override;
+
+	// Called on a fresh format context before it is opened, custom I/O goes here
+	virtual bool prepare();
 
-private:
 	AVDictionary* mOptions = NULL;
 	AVFormatContext* mFormatContext = NULL;
 	AVCodec* mCodec = NULL;
@@ -32,8 +38,43 @@ private:
 	int mVideoStream = -1;
 	AVPacket* mPacket = NULL;
 
+private:
 	std::string mUrl = "";
 
+	// Inputs with the same url and options decode once, followers take references from the leader
+	bool mShared = false;
+	std::string mKey = "";
+	std::shared_ptr<Source> mSource;
+	bool mLeader = false;
+
+	// Part of a file split at keyframes, runs from the first keyframe at begin to the first keyframe at end
+	bool segment();
+	size_t mSegmentIndex = 0;
+	size_t mSegmentCount = 1;
+	int64_t mSegmentBegin = AV_NOPTS_VALUE;
+	int64_t mSegmentEnd = AV_NOPTS_VALUE;
+	bool mSegmentStarted = true;
+
+	// Decoder writes into buffers of the input's pool, taken from the frame arena, instead of its own
+	static int buffer(AVCodecContext* context, AVFrame* frame, int flags);
+	AVBufferRef* pool(size_t size);
+	bool mPool = true;
+	AVBufferPool* mBufferPool = NULL;
+	size_t mBufferSize = 0;
+	std::mutex mPoolLock;
+
+	// Codec parameters of the last successful probe, reconnects skip avformat_find_stream_info
+	bool restore();
+	void remember();
+	void forget();
+	bool load();
+	void save() const;
+
+	std::string mProbeFile = "";
+	AVCodecParameters* mProbe = NULL;
+	int mProbeStream = -1;
+	bool mRestored = false;
+
 };
 
 }
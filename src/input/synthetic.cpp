@@ -0,0 +1,223 @@
+#include "synthetic.h"
+
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "arena.h"
+
+namespace Sight::Input {
+
+Synthetic::Synthetic(const json& config,
+                     size_t id,
+                     std::vector<Slot>& slot,
+                     std::vector<Queue<Handle>>& queue,
+                     std::vector<size_t>& queueId) :
+	Dummy(config, id, slot, queue, queueId) {
+	mWidth = config["width"];
+	mHeight = config["height"];
+	if (config.contains("format")) {
+		std::string format = config["format"];
+		mFormat = av_get_pix_fmt(format.c_str());
+	}
+	if (config.contains("fps")) {
+		mFps = config["fps"];
+	}
+	if (config.contains("pattern")) {
+		mPattern = config["pattern"];
+	}
+	if (config.contains("speed")) {
+		mSpeed = config["speed"];
+	}
+}
+
+Synthetic::Synthetic(Synthetic&& other) noexcept :
+	Dummy(std::move(other)),
+	mWidth(std::exchange(other.mWidth, 0)),
+	mHeight(std::exchange(other.mHeight, 0)),
+	mFormat(std::exchange(other.mFormat, AV_PIX_FMT_NONE)),
+	mFps(std::exchange(other.mFps, 0.0)),
+	mPattern(std::move(other.mPattern)),
+	mSpeed(std::exchange(other.mSpeed, 0)),
+	mPicture(std::exchange(other.mPicture, nullptr)) {
+}
+
+Synthetic::~Synthetic() {
+	av_frame_free(&mPicture);
+}
+
+bool Synthetic::validate(const json& config) {
+	if (!Dummy::validate(config)) {
+		return false;
+	}
+	if (!config.contains("width") || !config["width"].is_number_unsigned() || config["width"] == 0 ||
+	    !config.contains("height") || !config["height"].is_number_unsigned() || config["height"] == 0) {
+		LOG(ERROR) << "Width or height is not exists or not positive number";
+		return false;
+	}
+	if (config.contains("format")) {
+		if (!config["format"].is_string()) {
+			LOG(ERROR) << "Format is not string";
+			return false;
+		}
+		std::string format = config["format"];
+		AVPixelFormat pixFormat = av_get_pix_fmt(format.c_str());
+		const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixFormat);
+		if (pixFormat == AV_PIX_FMT_NONE || !desc ||
+		    (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL))) {
+			LOG(ERROR) << "Unsupported pixel format = " << format;
+			return false;
+		}
+	}
+	if (config.contains("fps") && (!config["fps"].is_number() || config["fps"] < 0)) {
+		LOG(ERROR) << "Fps is not a non negative number";
+		return false;
+	}
+	if (config.contains("pattern") &&
+	    (!config["pattern"].is_string() ||
+	     (config["pattern"] != "bars" && config["pattern"] != "gradient" && config["pattern"] != "moving"))) {
+		LOG(ERROR) << "Pattern is not one of bars, gradient or moving";
+		return false;
+	}
+	if (config.contains("speed") && !config["speed"].is_number_unsigned()) {
+		LOG(ERROR) << "Speed is not unsigned number";
+		return false;
+	}
+	return true;
+}
+
+bool Synthetic::start() {
+	if (!draw()) {
+		return false;
+	}
+	mNumber = 0;
+	mBegin = std::chrono::steady_clock::now();
+	LOG(INFO) << mName
+	          << ": Synthetic frame size: " << mWidth << "x" << mHeight
+	          << ", pixel format: " << av_get_pix_fmt_name(mFormat)
+	          << ", fps: " << mFps
+	          << ", pattern: " << mPattern;
+	return true;
+}
+
+void Synthetic::stop() {
+	av_frame_free(&mPicture);
+}
+
+bool Synthetic::draw() {
+	// Draw in YUV and convert once to the requested format
+	AVFrame* yuv = av_frame_alloc();
+	mPicture = av_frame_alloc();
+	if (!yuv || !mPicture) {
+		av_frame_free(&yuv);
+		LOG(ERROR) << mName << ": Failed to allocate memory for AVFrame";
+		return false;
+	}
+	yuv->width = mPicture->width = mWidth;
+	yuv->height = mPicture->height = mHeight;
+	yuv->format = AV_PIX_FMT_YUV444P;
+	mPicture->format = mFormat;
+	if (av_frame_get_buffer(yuv, 0) < 0 || av_frame_get_buffer(mPicture, 0) < 0) {
+		av_frame_free(&yuv);
+		LOG(ERROR) << mName << ": Failed to allocate frame buffer";
+		return false;
+	}
+
+	// Colors of the classic eight bars in YUV
+	static const uint8_t bars[8][3] = {
+		{235, 128, 128}, {210, 16, 146}, {170, 166, 16}, {145, 54, 34},
+		{106, 202, 222}, {81, 90, 240}, {41, 240, 110}, {16, 128, 128}
+	};
+	for (int y = 0; y < mHeight; ++y) {
+		for (int x = 0; x < mWidth; ++x) {
+			uint8_t color[3];
+			if (mPattern == "gradient") {
+				color[0] = (uint8_t)(16 + 219 * x / mWidth);
+				color[1] = (uint8_t)(16 + 224 * y / mHeight);
+				color[2] = 128;
+			} else {
+				std::memcpy(color, bars[x * 8 / mWidth], sizeof(color));
+			}
+			for (int plane = 0; plane < 3; ++plane) {
+				yuv->data[plane][y * yuv->linesize[plane] + x] = color[plane];
+			}
+		}
+	}
+
+	SwsContext* context = sws_getContext(mWidth, mHeight, AV_PIX_FMT_YUV444P,
+	                                     mWidth, mHeight, mFormat,
+	                                     SWS_POINT, NULL, NULL, NULL);
+	if (!context) {
+		av_frame_free(&yuv);
+		LOG(ERROR) << mName << ": Failed to create SwsContext";
+		return false;
+	}
+	sws_scale(context, (const uint8_t* const*)yuv->data, yuv->linesize, 0,
+	          mHeight, mPicture->data, mPicture->linesize);
+	sws_freeContext(context);
+	av_frame_free(&yuv);
+	return true;
+}
+
+Dummy::Result Synthetic::read(AVFrame* frame) {
+	// Pace to the configured rate, zero means as fast as slots are free
+	if (mFps > 0.0) {
+		auto due = mBegin + std::chrono::microseconds((int64_t)(mNumber * 1000000.0 / mFps));
+		std::this_thread::sleep_until(due);
+	}
+
+	// A buffer still referenced elsewhere is never drawn over
+	if (frame->width != mWidth || frame->height != mHeight || frame->format != mFormat || !frame->buf[0] ||
+	    !av_buffer_is_writable(frame->buf[0])) {
+		av_frame_unref(frame);
+		frame->width = mWidth;
+		frame->height = mHeight;
+		frame->format = mFormat;
+		if (!Arena::allocate(frame)) {
+			LOG(ERROR) << mName << ": Failed to allocate frame buffer";
+			return Result::error;
+		}
+	}
+
+	// Copy every row, shifted and wrapped around for the moving pattern
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(mFormat);
+	int shift = mPattern == "moving" ? (int)((mNumber * mSpeed) % mWidth) : 0;
+	shift &= ~((1 << desc->log2_chroma_w) - 1);
+	for (int plane = 0; plane < 4 && mPicture->data[plane]; ++plane) {
+		bool chroma = plane == 1 || plane == 2;
+		int rows = chroma ? -((-mHeight) >> desc->log2_chroma_h) : mHeight;
+		int columns = chroma ? -((-mWidth) >> desc->log2_chroma_w) : mWidth;
+		int step = 0;
+		for (int comp = 0; comp < desc->nb_components; ++comp) {
+			if (desc->comp[comp].plane == plane) {
+				step = desc->comp[comp].step;
+				break;
+			}
+		}
+		size_t bytes = (size_t)columns * step;
+		size_t offset = (size_t)(chroma ? shift >> desc->log2_chroma_w : shift) * step;
+		for (int y = 0; y < rows; ++y) {
+			const uint8_t* src = mPicture->data[plane] + y * mPicture->linesize[plane];
+			uint8_t* dst = frame->data[plane] + y * frame->linesize[plane];
+			std::memcpy(dst, src + offset, bytes - offset);
+			std::memcpy(dst + bytes - offset, src, offset);
+		}
+	}
+
+	frame->pts = mNumber;
+	frame->pkt_dts = mNumber;
+	frame->coded_picture_number = (int)mNumber;
+	frame->key_frame = 1;
+	++mNumber;
+	return Result::success;
+}
+
+AVRational Synthetic::timeBase() const {
+	// Frame number is the timestamp
+	if (mFps > 0.0) {
+		return {1000, (int)(mFps * 1000.0)};
+	}
+	return {1, 25};
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "dummy.h"
+
+namespace Sight::Input {
+
+class Synthetic
+	: public Dummy {
+public:
+	Synthetic(const json& config,
+	          size_t id,
+	          std::vector<Slot>& slot,
+	          std::vector<Queue<Handle>>& queue,
+	          std::vector<size_t>& queueId);
+	Synthetic(const Synthetic& other) = delete;
+	Synthetic(Synthetic&& other) noexcept;
+	~Synthetic();
+
+	static bool validate(const json& config);
+
+protected:
+	bool start() override;
+	void stop() override;
+	Result read(AVFrame* frame) override;
+	AVRational timeBase() const override;
+
+private:
+	bool draw();
+
+	int mWidth = 0;
+	int mHeight = 0;
+	AVPixelFormat mFormat = AV_PIX_FMT_YUV420P;
+	double mFps = 0.0;
+	std::string mPattern = "bars";
+	int mSpeed = 4;
+
+	// Pattern drawn once, frames are copies of it shifted for the moving pattern
+	AVFrame* mPicture = NULL;
+	int64_t mNumber = 0;
+	std::chrono::steady_clock::time_point mBegin;
+
+};
+
+}
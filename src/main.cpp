@@ -1,6 +1,8 @@
 #include <cstdlib>
 #include <csignal>
+#include <algorithm>
 #include <list>
+#include <set>
 #include <string>
 #include <fstream>
 #include <streambuf>
@@ -9,31 +11,41 @@
 #include <gflags/gflags.h>
 
 #include "pipeline.h"
+#include "arena.h"
+#include "metrics.h"
+#include "trace.h"
 
 using namespace Sight;
 
 DEFINE_string(config, "./config.json", "path to config file");
+DEFINE_bool(trace, false, "record per frame trace stamps, dump them on SIGUSR1 and exit");
+DEFINE_string(trace_file, "./sight-trace.json", "path to trace file in Chrome trace format");
+DEFINE_int32(metrics_port, 0, "port of the Prometheus metrics endpoint, 0 disables it");
+DEFINE_string(metrics_address, "127.0.0.1", "address of the Prometheus metrics endpoint");
+DEFINE_int32(arena_size, 0, "MiB of pre-faulted huge page memory for frame buffers, 0 disables the arena");
 
 volatile static std::sig_atomic_t gSignal = 0;
+volatile static std::sig_atomic_t gDump = 0;
+volatile static std::sig_atomic_t gReload = 0;
 
 static void signalHandler(int signal) {
 	if (signal == SIGINT) {
 		LOG(INFO) << "Terminate";
 		gSignal = signal;
+	} else if (signal == SIGUSR1) {
+		gDump = 1;
+	} else if (signal == SIGHUP) {
+		gReload = 1;
 	}
 }
 
-int main(int argc, char** argv) {
-	google::InitGoogleLogging(argv[0]);
-	google::InstallFailureSignalHandler();
-	gflags::ParseCommandLineFlags(&argc, &argv, true);
-
-	LOG(INFO) << "Using config file: " << FLAGS_config;
-	std::ifstream file(FLAGS_config);
-	std::string input, err;
+static bool load(const std::string& path, json& config) {
+	LOG(INFO) << "Using config file: " << path;
+	std::ifstream file(path);
+	std::string input;
 	if (!file.is_open()) {
 		LOG(ERROR) << "Can't open config file";
-		return EXIT_FAILURE;
+		return false;
 	}
 
 	file.seekg(0, std::ios::end);
@@ -42,44 +54,142 @@ int main(int argc, char** argv) {
 	input.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 	if (file.fail()) {
 		LOG(ERROR) << "Can't read config file";
-		return EXIT_FAILURE;
+		return false;
 	}
 
-	json config;
 	try {
 		config = json::parse(input);
 	} catch (json::parse_error& e) {
 		LOG(ERROR) << "JSON parse error: " << e.what();
-		return EXIT_FAILURE;
+		return false;
 	}
 	// LOG(INFO) << "Loaded config: \n" << config.dump(4);
 
-	std::list<std::unique_ptr<Pipeline>> pipeline;
-	if (config["pipeline"].is_array()) {
-		for (size_t id = 0; id < config["pipeline"].size(); ++id) {
-			if (config["pipeline"][id].is_object()) {
-				auto pipe = config["pipeline"][id];
-				if (Pipeline::validate(pipe)) {
-					pipeline.push_back(std::make_unique<Pipeline>(pipe, id));
-				} else {
-					LOG(ERROR) << "Incorrect pipeline config, pipeline = " << id;
-				}
+	if (!config.contains("pipeline") || !config["pipeline"].is_array()) {
+		LOG(ERROR) << "Config has no pipelines";
+		return false;
+	}
+	return true;
+}
+
+// Valid pipeline configs, expanded and in config order, valid tells whether every entry was
+static std::vector<json> pipelines(const json& config, bool& valid) {
+	std::vector<json> result;
+	valid = true;
+	std::set<std::string> names;
+	for (size_t id = 0; id < config["pipeline"].size(); ++id) {
+		if (config["pipeline"][id].is_object()) {
+			auto pipe = Pipeline::expand(config["pipeline"][id]);
+			if (!Pipeline::validate(pipe)) {
+				LOG(ERROR) << "Incorrect pipeline config, pipeline = " << id;
+				valid = false;
+			} else if (names.contains(pipe["name"])) {
+				LOG(ERROR) << "Pipeline names are not unique, name = " << pipe["name"];
+				valid = false;
 			} else {
-				LOG(ERROR) << "Pipeline config must be a dictionary, pipeline = " << id;
+				names.insert(pipe["name"]);
+				result.push_back(pipe);
 			}
+		} else {
+			LOG(ERROR) << "Pipeline config must be a dictionary, pipeline = " << id;
+			valid = false;
 		}
-	} else {
-		LOG(ERROR) << "Config has no pipelines";
+	}
+	return result;
+}
+
+// Keeps unchanged pipelines running, updates the ones that allow it and rebuilds the rest
+static void reload(std::list<std::unique_ptr<Pipeline>>& pipeline, size_t& pipelineId) {
+	json config;
+	if (!load(FLAGS_config, config)) {
+		LOG(ERROR) << "Reload failed, keeping current pipelines";
+		return;
+	}
+	// A pipeline left out for a typo would look removed and be terminated, so any invalid entry cancels the reload
+	bool valid = false;
+	auto configs = pipelines(config, valid);
+	if (!valid) {
+		LOG(ERROR) << "Reload failed, keeping current pipelines";
+		return;
+	}
+
+	auto it = pipeline.begin();
+	while (it != pipeline.end()) {
+		auto& p = *it;
+		auto found = std::find_if(configs.begin(), configs.end(), [&p](const json& c) {
+			return c["name"] == p->name();
+		});
+		if (found != configs.end() && (*found == p->config() || p->reconfigure(*found))) {
+			configs.erase(found);
+			++it;
+			continue;
+		}
+
+		LOG(INFO) << (found == configs.end() ? "Remove" : "Rebuild") << " pipeline " << p->name();
+		p->terminate();
+		p->wait();
+		it = pipeline.erase(it);
+	}
+
+	for (auto& c : configs) {
+		LOG(INFO) << "Start pipeline " << c["name"];
+		pipeline.push_back(std::make_unique<Pipeline>(c, pipelineId++));
+		pipeline.back()->run();
+	}
+}
+
+int main(int argc, char** argv) {
+	google::InitGoogleLogging(argv[0]);
+	google::InstallFailureSignalHandler();
+	gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+	json config;
+	if (!load(FLAGS_config, config)) {
 		return EXIT_FAILURE;
 	}
 
+	// Reserved before any pipeline so the first frames already land on faulted pages
+	if (FLAGS_arena_size > 0) {
+		Arena::reserve((size_t)FLAGS_arena_size * 1024 * 1024);
+	}
+
+	size_t pipelineId = 0;
+	std::list<std::unique_ptr<Pipeline>> pipeline;
+	bool valid = false;
+	for (auto& c : pipelines(config, valid)) {
+		pipeline.push_back(std::make_unique<Pipeline>(c, pipelineId++));
+	}
+
+	Trace::enable(FLAGS_trace);
+
+	Metrics::Server metrics;
+	if (FLAGS_metrics_port > 0) {
+		if (!metrics.start(FLAGS_metrics_address, FLAGS_metrics_port)) {
+			return EXIT_FAILURE;
+		}
+	}
+
 	LOG(INFO) << "Starting";
 	for (auto& p : pipeline) {
 		p->run();
 	}
 
 	std::signal(SIGINT, signalHandler);
+	std::signal(SIGUSR1, signalHandler);
+	std::signal(SIGHUP, signalHandler);
 	while (gSignal == 0 && !pipeline.empty()) {
+		if (gReload != 0) {
+			gReload = 0;
+			LOG(INFO) << "Reload";
+			reload(pipeline, pipelineId);
+		}
+		if (gDump != 0) {
+			gDump = 0;
+			if (Trace::enabled()) {
+				Trace::dump(FLAGS_trace_file);
+			}
+		}
+
 		auto it = pipeline.begin();
 		while (it != pipeline.end()) {
 			if (!(*it)->running()) {
@@ -104,6 +214,10 @@ int main(int argc, char** argv) {
 	}
 	pipeline.clear();
 
+	if (Trace::enabled()) {
+		Trace::dump(FLAGS_trace_file);
+	}
+
 	LOG(INFO) << "Stopped";
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,287 @@
+#include "metrics.h"
+
+#include <bit>
+#include <iomanip>
+#include <sstream>
+#include <variant>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+namespace Sight::Metrics {
+
+namespace {
+
+struct Family {
+	std::string mType;
+	std::string mHelp;
+	std::map<Labels, std::variant<std::unique_ptr<Counter>,
+	                              std::unique_ptr<Gauge>,
+	                              std::unique_ptr<Histogram>>> mMetric;
+};
+
+std::mutex gLock;
+std::map<std::string, Family> gFamily;
+
+template <typename T>
+T& lookup(const std::string& name, const std::string& type, const std::string& help, const Labels& labels) {
+	std::lock_guard<std::mutex> lg(gLock);
+	auto& family = gFamily[name];
+	if (family.mType.empty()) {
+		family.mType = type;
+		family.mHelp = help;
+	}
+	auto it = family.mMetric.find(labels);
+	if (it == family.mMetric.end()) {
+		it = family.mMetric.emplace(labels, std::make_unique<T>()).first;
+	}
+	return *std::get<std::unique_ptr<T>>(it->second);
+}
+
+std::string format(const Labels& labels, const std::string& extra = "") {
+	if (labels.empty() && extra.empty()) {
+		return "";
+	}
+	std::string result = "{";
+	for (auto& [key, value] : labels) {
+		std::string escaped;
+		for (char c : value) {
+			if (c == '\\' || c == '"') {
+				escaped += '\\';
+			}
+			escaped += c == '\n' ? 'n' : c;
+		}
+		result += (result.size() > 1 ? "," : "") + key + "=\"" + escaped + "\"";
+	}
+	if (!extra.empty()) {
+		result += (result.size() > 1 ? "," : "") + extra;
+	}
+	return result + "}";
+}
+
+}
+
+size_t shard() {
+	static std::atomic_size_t next = 0;
+	thread_local size_t id = next++ % kShards;
+	return id;
+}
+
+void Counter::add(uint64_t value) {
+	mShard[shard()].mValue.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Counter::value() const {
+	uint64_t result = 0;
+	for (auto& s : mShard) {
+		result += s.mValue.load(std::memory_order_relaxed);
+	}
+	return result;
+}
+
+void Gauge::set(int64_t value) {
+	mValue.store(value, std::memory_order_relaxed);
+}
+
+void Gauge::add(int64_t value) {
+	mValue.fetch_add(value, std::memory_order_relaxed);
+}
+
+int64_t Gauge::value() const {
+	return mValue.load(std::memory_order_relaxed);
+}
+
+size_t Histogram::bucket(uint64_t usec) {
+	// Buckets include their upper bound like Prometheus le, so place the value below it
+	usec = usec > 0 ? usec - 1 : 0;
+
+	// Values below 2^kSubBits get exact buckets, above that the top kSubBits bits after the leading one
+	if (usec < (1 << kSubBits)) {
+		return usec;
+	}
+	size_t exponent = std::bit_width(usec) - 1;
+	size_t sub = (usec >> (exponent - kSubBits)) & ((1 << kSubBits) - 1);
+	size_t result = ((exponent - kSubBits + 1) << kSubBits) + sub;
+	return result < kBuckets ? result : kBuckets - 1;
+}
+
+uint64_t Histogram::upper(size_t bucket) {
+	if (bucket < (1 << kSubBits)) {
+		return bucket + 1;
+	}
+	size_t exponent = (bucket >> kSubBits) + kSubBits - 1;
+	size_t sub = bucket & ((1 << kSubBits) - 1);
+	return ((uint64_t)((1 << kSubBits) + sub + 1)) << (exponent - kSubBits);
+}
+
+void Histogram::observe(int64_t usec) {
+	uint64_t value = usec > 0 ? usec : 0;
+	auto& s = mShard[shard()];
+	s.mBucket[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+	s.mCount.fetch_add(1, std::memory_order_relaxed);
+	s.mSum.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::count() const {
+	uint64_t result = 0;
+	for (auto& s : mShard) {
+		result += s.mCount.load(std::memory_order_relaxed);
+	}
+	return result;
+}
+
+uint64_t Histogram::sum() const {
+	uint64_t result = 0;
+	for (auto& s : mShard) {
+		result += s.mSum.load(std::memory_order_relaxed);
+	}
+	return result;
+}
+
+uint64_t Histogram::atMost(uint64_t usec) const {
+	uint64_t result = 0;
+	for (size_t b = 0; b < kBuckets && upper(b) <= usec; ++b) {
+		for (auto& s : mShard) {
+			result += s.mBucket[b].load(std::memory_order_relaxed);
+		}
+	}
+	return result;
+}
+
+Counter& counter(const std::string& name, const std::string& help, const Labels& labels) {
+	return lookup<Counter>(name, "counter", help, labels);
+}
+
+Gauge& gauge(const std::string& name, const std::string& help, const Labels& labels) {
+	return lookup<Gauge>(name, "gauge", help, labels);
+}
+
+Histogram& histogram(const std::string& name, const std::string& help, const Labels& labels) {
+	return lookup<Histogram>(name, "histogram", help, labels);
+}
+
+std::string render() {
+	std::ostringstream out;
+	std::lock_guard<std::mutex> lg(gLock);
+	for (auto& [name, family] : gFamily) {
+		out << "# HELP " << name << " " << family.mHelp << "\n";
+		out << "# TYPE " << name << " " << family.mType << "\n";
+		for (auto& [labels, metric] : family.mMetric) {
+			if (auto c = std::get_if<std::unique_ptr<Counter>>(&metric)) {
+				out << name << format(labels) << " " << (*c)->value() << "\n";
+			} else if (auto g = std::get_if<std::unique_ptr<Gauge>>(&metric)) {
+				out << name << format(labels) << " " << (*g)->value() << "\n";
+			} else if (auto h = std::get_if<std::unique_ptr<Histogram>>(&metric)) {
+				// Bucket bounds at powers of two from 128us to 128s, they are exact in log linear buckets
+				for (uint64_t usec = 1 << 7; usec <= (1ull << 27); usec <<= 1) {
+					std::ostringstream le;
+					le << std::fixed << std::setprecision(6) << "le=\"" << (double)usec / 1000000.0 << "\"";
+					out << name << "_bucket" << format(labels, le.str()) << " " << (*h)->atMost(usec) << "\n";
+				}
+				out << name << "_bucket" << format(labels, "le=\"+Inf\"") << " " << (*h)->count() << "\n";
+				out << name << "_sum" << format(labels) << " " << (double)(*h)->sum() / 1000000.0 << "\n";
+				out << name << "_count" << format(labels) << " " << (*h)->count() << "\n";
+			}
+		}
+	}
+	return out.str();
+}
+
+Server::Server() {
+}
+
+Server::~Server() {
+	stop();
+}
+
+bool Server::start(const std::string& address, uint16_t port) {
+	mSocket = socket(AF_INET, SOCK_STREAM, 0);
+	if (mSocket < 0) {
+		LOG(ERROR) << "Metrics: Can't create socket";
+		return false;
+	}
+	int reuse = 1;
+	setsockopt(mSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+		LOG(ERROR) << "Metrics: Incorrect address = " << address;
+		close(mSocket);
+		mSocket = -1;
+		return false;
+	}
+	if (bind(mSocket, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(mSocket, 8) < 0) {
+		LOG(ERROR) << "Metrics: Can't listen on " << address << ":" << port;
+		close(mSocket);
+		mSocket = -1;
+		return false;
+	}
+
+	mRun.test_and_set();
+	mWorker = std::thread(&Server::worker, this);
+	LOG(INFO) << "Metrics: Serving on http://" << address << ":" << port << "/metrics";
+	return true;
+}
+
+void Server::stop() {
+	if (mRun.test()) {
+		mRun.clear();
+		mWorker.join();
+	}
+	if (mSocket >= 0) {
+		close(mSocket);
+		mSocket = -1;
+	}
+}
+
+void Server::worker() {
+	pthread_setname_np(pthread_self(), "metrics:server");
+	while (mRun.test()) {
+		// Poll with timeout to stay responsive to stop
+		pollfd pfd = {.fd = mSocket, .events = POLLIN, .revents = 0};
+		if (poll(&pfd, 1, 200) <= 0) {
+			continue;
+		}
+		int client = accept(mSocket, NULL, NULL);
+		if (client < 0) {
+			continue;
+		}
+
+		char request[1024];
+		ssize_t size = recv(client, request, sizeof(request) - 1, 0);
+		std::string line(request, size > 0 ? size : 0);
+		std::string status = "404 Not Found";
+		std::string body = "Not found\n";
+		if (line.starts_with("GET /metrics ") || line.starts_with("GET /metrics?")) {
+			status = "200 OK";
+			body = render();
+		}
+
+		std::ostringstream response;
+		response << "HTTP/1.1 " << status << "\r\n"
+		         << "Content-Type: text/plain; version=0.0.4\r\n"
+		         << "Content-Length: " << body.size() << "\r\n"
+		         << "Connection: close\r\n\r\n"
+		         << body;
+		std::string data = response.str();
+		size_t sent = 0;
+		while (sent < data.size()) {
+			ssize_t n = send(client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+			if (n <= 0) {
+				break;
+			}
+			sent += n;
+		}
+		close(client);
+	}
+}
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Sight::Metrics {
+
+using Labels = std::map<std::string, std::string>;
+
+// Number of per thread shards, hot paths of different threads never share a cache line
+constexpr size_t kShards = 16;
+
+size_t shard();
+
+class Counter {
+public:
+	void add(uint64_t value = 1);
+	uint64_t value() const;
+
+private:
+	struct alignas(64) Shard {
+		std::atomic_uint64_t mValue = 0;
+	};
+	std::array<Shard, kShards> mShard;
+
+};
+
+class Gauge {
+public:
+	void set(int64_t value);
+	void add(int64_t value);
+	int64_t value() const;
+
+private:
+	std::atomic_int64_t mValue = 0;
+
+};
+
+// Log linear buckets of microseconds, 8 buckets per power of two, each includes its upper bound
+class Histogram {
+public:
+	static constexpr size_t kSubBits = 3;
+	static constexpr size_t kBuckets = (40 - kSubBits) << kSubBits;
+
+	void observe(int64_t usec);
+
+	uint64_t count() const;
+	uint64_t sum() const;
+	uint64_t atMost(uint64_t usec) const;
+
+	static size_t bucket(uint64_t usec);
+	static uint64_t upper(size_t bucket);
+
+private:
+	struct alignas(64) Shard {
+		std::array<std::atomic_uint64_t, kBuckets> mBucket = {};
+		std::atomic_uint64_t mCount = 0;
+		std::atomic_uint64_t mSum = 0;
+	};
+	std::array<Shard, kShards> mShard;
+
+};
+
+Counter& counter(const std::string& name, const std::string& help, const Labels& labels = {});
+Gauge& gauge(const std::string& name, const std::string& help, const Labels& labels = {});
+Histogram& histogram(const std::string& name, const std::string& help, const Labels& labels = {});
+
+std::string render();
+
+// Local HTTP endpoint serving GET /metrics in Prometheus text format
+class Server {
+public:
+	Server();
+	Server(const Server& other) = delete;
+	~Server();
+
+	bool start(const std::string& address, uint16_t port);
+	void stop();
+
+private:
+	void worker();
+
+	int mSocket = -1;
+	std::atomic_flag mRun = ATOMIC_FLAG_INIT;
+	std::thread mWorker;
+
+};
+
+}
@@ -2,6 +2,9 @@
 
 #include <glog/logging.h>
 
+#include "slot.h"
+#include "trace.h"
+
 namespace Sight {
 
 Module::Module(const json& config,
@@ -9,12 +12,27 @@ Module::Module(const json& config,
 	mId(id) {
 	mName = config["name"];
 	mType = config["type"];
+	if (config.contains("pipeline")) {
+		mPipeline = config["pipeline"];
+	}
+	if (config.contains("thread")) {
+		mThread = Thread(config["thread"]);
+	}
+
+	mFramesIn = &Metrics::counter("sight_frames_in_total", "Frames received by the module", labels());
+	mFramesOut = &Metrics::counter("sight_frames_out_total", "Frames passed on by the module", labels());
+	mFramesDropped = &Metrics::counter("sight_frames_dropped_total", "Frames dropped by the module", labels());
 }
 
 Module::Module(Module&& other) noexcept :
 	mId(std::exchange(other.mId, 0)),
 	mName(std::move(other.mName)),
-	mType(std::move(other.mType)) {
+	mType(std::move(other.mType)),
+	mPipeline(std::move(other.mPipeline)),
+	mThread(other.mThread),
+	mFramesIn(other.mFramesIn),
+	mFramesOut(other.mFramesOut),
+	mFramesDropped(other.mFramesDropped) {
 	if (other.mRun.test()) {
 		other.terminate();
 		other.wait();
@@ -36,17 +54,31 @@ bool Module::validate(const json& config) {
 		LOG(ERROR) << "Type is not exists, not string or empty";
 		return false;
 	}
+	if (config.contains("thread") && !Thread::validate(config["thread"], true)) {
+		return false;
+	}
 	return true;
 }
 
-uint32_t Module::pack(uint16_t stream, uint8_t slot, bool flag) {
-	return (stream << 16) | (slot << 8) | (flag ? 0x1 : 0x0);
+const std::string& Module::name() const {
+	return mName;
+}
+
+Metrics::Labels Module::labels() const {
+	return {{"pipeline", mPipeline}, {"module", mName}, {"type", mType}};
 }
 
-void Module::unpack(uint32_t packed, uint16_t& stream, uint8_t& slot, bool& flag) {
-	stream = packed >> 16;
-	slot = (packed >> 8) & 0xffff;
-	flag = packed & 0x1;
+// Stream in bits 48-63, slot in 32-47, generation in 8-31, flags in 0-7
+Handle Module::pack(uint16_t stream, uint16_t slot, uint32_t generation, bool flag) {
+	return ((Handle)stream << 48) | ((Handle)slot << 32) |
+	       ((Handle)(generation & Slot::kGenerationMask) << 8) | (flag ? 0x1 : 0x0);
+}
+
+void Module::unpack(Handle handle, uint16_t& stream, uint16_t& slot, uint32_t& generation, bool& flag) {
+	stream = handle >> 48;
+	slot = (handle >> 32) & 0xffff;
+	generation = (handle >> 8) & Slot::kGenerationMask;
+	flag = handle & 0x1;
 }
 
 void Module::run() {
@@ -87,6 +119,10 @@ void Module::task() {
 	std::this_thread::sleep_for(std::chrono::milliseconds(500));
 }
 
+bool Module::recover() {
+	return false;
+}
+
 bool Module::active() {
 	return mRun.test();
 }
@@ -97,13 +133,18 @@ void Module::deactivate() {
 
 void Module::worker() {
 	pthread_setname_np(pthread_self(), (mName + ":worker").c_str());
+	Trace::thread(mName + ":worker");
+	mThread.apply(mName);
 	if (start()) {
 		LOG(INFO) << mName << ": Started";
-		while (mRun.test()) {
-			task();
-		}
 	} else {
 		LOG(ERROR) << mName << ": Start failed";
+		if (!recover()) {
+			mRun.clear();
+		}
+	}
+	while (mRun.test()) {
+		task();
 	}
 	stop();
 	LOG(INFO) << mName << ": Stopped";
@@ -6,10 +6,16 @@
 
 #include <nlohmann/json.hpp>
 
+#include "metrics.h"
+#include "thread.h"
+
 namespace Sight {
 
 using json = nlohmann::json;
 
+// Slot reference passed through queues, see Module::pack
+using Handle = uint64_t;
+
 class Module {
 public:
 	Module(const json& config,
@@ -22,6 +28,7 @@ public:
 	bool running() const;
 	void terminate();
 	void wait();
+	const std::string& name() const;
 
 	static bool validate(const json& config);
 
@@ -29,6 +36,8 @@ protected:
 	virtual bool start();
 	virtual void stop();
 	virtual void task();
+	// Called when start fails, true keeps the worker running so task can retry
+	virtual bool recover();
 
 	bool active();
 	void deactivate();
@@ -36,9 +45,19 @@ protected:
 	size_t mId = 0;
 	std::string mName;
 	std::string mType;
+	std::string mPipeline;
+
+	Metrics::Labels labels() const;
+
+	// Affinity, policy and nice of the worker, helper threads of the module apply it too
+	Thread mThread;
+
+	Metrics::Counter* mFramesIn = nullptr;
+	Metrics::Counter* mFramesOut = nullptr;
+	Metrics::Counter* mFramesDropped = nullptr;
 
-	static uint32_t pack(uint16_t stream, uint8_t slot, bool flag);
-	static void unpack(uint32_t packed, uint16_t& stream, uint8_t& slot, bool& flag);
+	static Handle pack(uint16_t stream, uint16_t slot, uint32_t generation, bool flag);
+	static void unpack(Handle handle, uint16_t& stream, uint16_t& slot, uint32_t& generation, bool& flag);
 
 private:
 	std::atomic_flag mRun = ATOMIC_FLAG_INIT;
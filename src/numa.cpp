@@ -0,0 +1,92 @@
+#include "numa.h"
+
+#include <cstdint>
+#include <string>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#	include <sys/syscall.h>
+#elif defined(__FreeBSD__)
+#	include <sys/param.h>
+#	include <sys/cpuset.h>
+#	include <sys/domainset.h>
+#endif
+
+#include <glog/logging.h>
+
+namespace Sight {
+
+namespace {
+
+constexpr size_t kMaxNode = sizeof(unsigned long) * 8;
+
+#ifdef __linux__
+// From linux/mempolicy.h, FreeBSD takes domain sets instead
+constexpr int kPreferred = 1;
+constexpr int kBind = 2;
+
+void unmap(void* opaque, uint8_t* data) {
+	munmap(data, reinterpret_cast<uintptr_t>(opaque));
+}
+#endif
+
+}
+
+bool Numa::prefer(int node) {
+	if (node < 0 || (size_t)node >= kMaxNode) {
+		return false;
+	}
+	int result = -1;
+#if defined(__linux__)
+	unsigned long mask = 1ul << node;
+	result = syscall(SYS_set_mempolicy, kPreferred, &mask, kMaxNode);
+#elif defined(__FreeBSD__)
+	domainset_t mask;
+	DOMAINSET_ZERO(&mask);
+	DOMAINSET_SET(node, &mask);
+	result = cpuset_setdomain(CPU_LEVEL_WHICH, CPU_WHICH_TID, -1, sizeof(mask), &mask, DOMAINSET_POLICY_PREFER);
+#endif
+	if (result != 0) {
+		LOG(WARNING) << "Could not prefer memory of NUMA node " << node << ", error = " << errno;
+		return false;
+	}
+	return true;
+}
+
+AVBufferRef* Numa::buffer([[maybe_unused]]size_t size, [[maybe_unused]]int node) {
+#ifdef __linux__
+	if (node < 0 || (size_t)node >= kMaxNode || size == 0) {
+		return NULL;
+	}
+
+	// Heap memory is recycled by malloc and shares its mapping, binding it would pin other allocations too
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t length = (size + page - 1) & ~(page - 1);
+	void* data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+	unsigned long mask = 1ul << node;
+	if (syscall(SYS_mbind, data, length, kBind, &mask, kMaxNode, 0) != 0) {
+		LOG(WARNING) << "Could not bind memory to NUMA node " << node << ", error = " << errno;
+	}
+
+	AVBufferRef* buffer = av_buffer_create((uint8_t*)data, size, unmap, reinterpret_cast<void*>(length), 0);
+	if (!buffer) {
+		munmap(data, length);
+	}
+	return buffer;
+#else
+	// No policy per address range, the preferred domain of the allocating thread decides
+	return NULL;
+#endif
+}
+
+Metrics::Gauge& Numa::bytes(int node) {
+	return Metrics::gauge("sight_numa_bytes", "Frame memory placed on the NUMA node",
+	                      {{"node", node < 0 ? std::string("any") : std::to_string(node)}});
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+extern "C" {
+#	include <libavutil/buffer.h>
+}
+
+#include "metrics.h"
+
+namespace Sight {
+
+// Memory placement on NUMA nodes through the kernel policy calls, no libnuma needed
+class Numa {
+public:
+	// Later allocations of the calling thread come from the node while it has free memory
+	static bool prefer(int node);
+	// A mapping of its own bound to the node before its first touch, unmapped when the buffer is freed
+	static AVBufferRef* buffer(size_t size, int node);
+
+	// Bytes of frame memory placed on the node, exported per node
+	static Metrics::Gauge& bytes(int node);
+
+};
+
+}
@@ -9,7 +9,7 @@ namespace Sight::Output {
 Disk::Disk(const json& config,
            size_t id,
            std::vector<std::vector<Slot>>& slot,
-           Queue<uint32_t>& queue) :
+           Queue<Handle>& queue) :
 	Dummy(config, id, slot, queue),
 	mPath(config["path"]) {
 }
@@ -44,30 +44,19 @@ bool Disk::start() {
 	return Dummy::start();
 }
 
-bool Disk::send(Slot& slot) {
-	const AVFrame* frame = slot.frame();
-	if (frame == nullptr) {
-		LOG(ERROR) << mName << ": Error encodind frame";
-		return true;
-	}
-
-	const AVPacket* picture = packet(slot, AV_CODEC_ID_MJPEG);
-	if (picture == nullptr) {
-		LOG(ERROR) << mName << ": Error encodind packet";
-		return true;
-	}
-
-	auto& info = slot.info();
+bool Disk::send(Event& event) {
+	const AVPacket* picture = event.mPicture;
+	auto& info = event.mInfo;
 
 	LOG(INFO) << mName
-	          << ": Event stream name = " << slot.streamName()
+	          << ": Event stream name = " << event.mStreamName
 	          << ", timestamp = " << timestampNow()
-	          << ", frame number = " << frame->coded_picture_number
-	          << ", frame dts = " << frame->pkt_dts
-	          << ", frame pts = " << frame->pts
-	          << ", frame size = " << frame->pkt_size
-	          << ", frame width = " << frame->width
-	          << ", frame height = " << frame->height
+	          << ", frame number = " << event.mFrameNumber
+	          << ", frame dts = " << event.mDts
+	          << ", frame pts = " << event.mPts
+	          << ", frame size = " << event.mFrameSize
+	          << ", frame width = " << event.mWidth
+	          << ", frame height = " << event.mHeight
 	          << ", packet pts: " << picture->pts
 	          << ", packet dts: " << picture->dts
 	          << ", packet size: " << picture->size
@@ -75,7 +64,7 @@ bool Disk::send(Slot& slot) {
 	          << ", info = " << info.dump();
 
 	// Create stream directory if it does not exist
-	fs::path streamDir(mPath / slot.streamName());
+	fs::path streamDir(mPath / event.mStreamName);
 	if (!fs::directory_entry(streamDir).exists()) {
 		if (!fs::create_directory(streamDir)) {
 			LOG(ERROR) << mName
@@ -14,7 +14,7 @@ public:
 	Disk(const json& config,
 	     size_t id,
 	     std::vector<std::vector<Slot>>& slot,
-	     Queue<uint32_t>& queue);
+	     Queue<Handle>& queue);
 	Disk(const Disk& other) = delete;
 	Disk(Disk&& other) noexcept;
 	~Disk();
@@ -23,7 +23,7 @@ public:
 
 protected:
 	bool start() override;
-	bool send(Slot& slot) override;
+	bool send(Event& event) override;
 
 private:
 	fs::path mPath;
@@ -1,30 +1,55 @@
 #include "dummy.h"
 
 #include <chrono>
+#include <utility>
 
 #include <glog/logging.h>
 
+#include "trace.h"
+
 namespace Sight::Output {
 
 Dummy::Dummy(const json& config,
              size_t id,
              std::vector<std::vector<Slot>>& slot,
-             Queue<uint32_t>& queue) :
+             Queue<Handle>& queue) :
 	Module(config, id),
 	mSlot(slot),
 	mQueue(queue) {
+	mEncodeTime = &Metrics::histogram("sight_encode_seconds", "Time to encode an event picture", labels());
+	mSendTime = &Metrics::histogram("sight_send_seconds", "Time to send an event", labels());
+	mSendQueueDepth = &Metrics::gauge("sight_send_queue_depth", "Events waiting to be sent", labels());
+	mSendErrors = &Metrics::counter("sight_send_errors_total", "Events that failed to send", labels());
 	if (config.contains("local_time")) {
 		mLocalTime = config["local_time"];
 	}
 	if (config.contains("resend_interval")) {
 		mResendInterval = config["resend_interval"];
 	}
+	if (config.contains("segments")) {
+		for (auto& group : config["segments"]) {
+			Segments segments;
+			for (auto& streamId : group) {
+				mSegmentOf[streamId] = {mSegments.size(), segments.mStream.size()};
+				segments.mStream.push_back(streamId);
+			}
+			mSegments.push_back(segments);
+		}
+	}
 }
 
 Dummy::Dummy(Dummy&& other) noexcept :
 	Module(std::move(other)),
+	mEncodeTime(other.mEncodeTime),
+	mSendTime(other.mSendTime),
+	mSendQueueDepth(other.mSendQueueDepth),
+	mSendErrors(other.mSendErrors),
 	mSlot(other.mSlot),
-	mQueue(other.mQueue) {
+	mQueue(other.mQueue),
+	mSegments(std::move(other.mSegments)),
+	mSegmentOf(std::move(other.mSegmentOf)),
+	mHeld(std::move(other.mHeld)),
+	mDone(std::move(other.mDone)) {
 }
 
 Dummy::~Dummy() {
@@ -82,57 +107,142 @@ bool Dummy::start() {
 }
 
 void Dummy::stop() {
+	// Whatever is still held goes out in segment order
+	for (auto& segments : mSegments) {
+		for (; segments.mHead < segments.mStream.size(); ++segments.mHead) {
+			hand(segments.mStream[segments.mHead]);
+		}
+	}
+	mHeld.clear();
+	mSendQueue.notify();
+
+	// The sender drains the queue before it returns
 	if (mSend.test()) {
 		mSend.clear();
 		mSender.join();
 	}
+	if (mExpired > 0) {
+		LOG(WARNING) << mName << ": Skipped expired frames = " << mExpired;
+	}
 }
 
 void Dummy::task() {
 	if (mQueue.ready()) {
 		uint16_t streamId = 0;
-		uint8_t slotId = 0;
+		uint16_t slotId = 0;
+		uint32_t generation = 0;
 		bool send = false;
-		unpack(mQueue.get(), streamId, slotId, send);
+		unpack(mQueue.get(), streamId, slotId, generation, send);
 		auto& slot = mSlot[streamId][slotId];
+		if (slot.generation() != generation) {
+			// Its reference belongs to an earlier frame, releasing it would cut short the current one
+			LOG(ERROR) << mName << ": Stale handle, stream = " << streamId << ", slot = " << slotId;
+			mFramesDropped->add();
+			release();
+			return;
+		}
+		Trace::instant("dequeue", streamId, slotId, slot.source()->coded_picture_number);
+		mFramesIn->add();
+		if (send && slot.expired()) {
+			++mExpired;
+			mFramesDropped->add();
+			send = false;
+		}
+		Event event;
+		if (send && !this->event(slot, event)) {
+			LOG(ERROR) << mName << ": Could not encode event";
+			mSendErrors->add();
+			send = false;
+		}
+		slot.unref();
+		if (send && mSegmentOf.contains(streamId)) {
+			auto [group, index] = mSegmentOf[streamId];
+			if (index > mSegments[group].mHead) {
+				mHeld[streamId].push_back(std::move(event));
+				send = false;
+			}
+		}
 		if (send) {
-			mSendQueue.put(Slot(slot));
+			mSendQueue.put(std::move(event));
 			mSendQueue.notify();
+			mSendQueueDepth->set(mSendQueue.size());
 		}
-		slot.unref();
 	}
+	release();
 }
 
-bool Dummy::send(Slot& slot) {
-	const AVFrame* frame = slot.frame();
-	if (frame == nullptr) {
-		LOG(ERROR) << mName << ": Error encodind frame";
-		return false;
+void Dummy::finish(uint16_t streamId) {
+	mFinished.put(streamId);
+}
+
+void Dummy::release() {
+	if (mSegments.empty() || mFinished.size() == 0) {
+		return;
+	}
+	while (mFinished.size() > 0) {
+		mDone.insert(mFinished.get());
 	}
 
-	const AVPacket* picture = packet(slot, AV_CODEC_ID_MJPEG);
-	if (picture == nullptr) {
-		LOG(ERROR) << mName << ": Error encodind packet";
-		return false;
+	for (auto& segments : mSegments) {
+		while (segments.mHead < segments.mStream.size() && mDone.contains(segments.mStream[segments.mHead])) {
+			++segments.mHead;
+			if (segments.mHead < segments.mStream.size()) {
+				hand(segments.mStream[segments.mHead]);
+			}
+		}
 	}
+	mSendQueue.notify();
+	mSendQueueDepth->set(mSendQueue.size());
+}
 
-	auto& info = slot.info();
+void Dummy::hand(uint16_t streamId) {
+	auto& held = mHeld[streamId];
+	for (auto& event : held) {
+		mSendQueue.put(std::move(event));
+	}
+	held.clear();
+}
 
+bool Dummy::send(Event& event) {
 	LOG(INFO) << mName
-	          << ": Event stream name = " << slot.streamName()
+	          << ": Event stream name = " << event.mStreamName
 	          << ", timestamp = " << timestampNow()
-	          << ", frame number = " << frame->coded_picture_number
-	          << ", frame dts = " << frame->pkt_dts
-	          << ", frame pts = " << frame->pts
-	          << ", frame size = " << frame->pkt_size
-	          << ", frame width = " << frame->width
-	          << ", frame height = " << frame->height
-	          << ", packet pts: " << picture->pts
-	          << ", packet dts: " << picture->dts
-	          << ", packet size: " << picture->size
-	          << ", stream index: " << picture->stream_index
-	          << ", info = " << info.dump();
+	          << ", frame number = " << event.mFrameNumber
+	          << ", frame dts = " << event.mDts
+	          << ", frame pts = " << event.mPts
+	          << ", frame size = " << event.mFrameSize
+	          << ", frame width = " << event.mWidth
+	          << ", frame height = " << event.mHeight
+	          << ", packet pts: " << event.mPicture->pts
+	          << ", packet dts: " << event.mPicture->dts
+	          << ", packet size: " << event.mPicture->size
+	          << ", stream index: " << event.mPicture->stream_index
+	          << ", info = " << event.mInfo.dump();
+
+	return true;
+}
+
+bool Dummy::event(Slot& slot, Event& event) {
+	const AVPacket* picture = packet(slot, AV_CODEC_ID_MJPEG);
+	if (picture == nullptr) {
+		return false;
+	}
+	event.mPicture = av_packet_clone(picture);
+	if (!event.mPicture) {
+		return false;
+	}
 
+	const AVFrame* frame = slot.source();
+	event.mStreamId = slot.streamId();
+	event.mStreamName = slot.streamName();
+	event.mInfo = slot.info();
+	event.mFrameNumber = frame->coded_picture_number;
+	event.mDts = frame->pkt_dts;
+	event.mPts = frame->pts;
+	event.mFrameSize = frame->pkt_size;
+	event.mWidth = frame->width;
+	event.mHeight = frame->height;
+	event.mCaptured = slot.captured();
 	return true;
 }
 
@@ -207,11 +317,14 @@ const AVPacket* Dummy::packet(Slot& slot, AVCodecID format) {
 		encoder = &mEncoder[streamId];
 	}
 
+	int64_t begin = Trace::now();
 	int response = avcodec_send_frame(encoder->mContext, &frame);
 	if (response >= 0) {
 		response = avcodec_receive_packet(encoder->mContext, mPacket[streamId].mPacket);
 		if (response >= 0) {
 			mPacket[streamId].mFrameId = frame.coded_picture_number;
+			mEncodeTime->observe(Trace::now() - begin);
+			Trace::complete("encode", begin, streamId, 0, frame.coded_picture_number);
 		} else {
 			LOG(ERROR) << mName
 			           << ": Could not receive packet, error = " << response
@@ -228,23 +341,78 @@ const AVPacket* Dummy::packet(Slot& slot, AVCodecID format) {
 	return mPacket[streamId].mPacket;
 }
 
+std::string Dummy::body(const AVPacket* picture, const json& info) {
+	std::vector<uint8_t> image;
+	image.assign(picture->data, picture->data + picture->size);
+
+	json body;
+	body["timestamp"] = timestampNow();
+
+	body["files"] = json::array();
+	body["files"].push_back(json::object());
+	body["files"].back()["file"] = json::binary(image);
+	body["files"].back()["is_main"] = true;
+	body["files"].back()["format"] = "jpg";
+
+	// Last processing stage describes the event
+	if (!info.empty()) {
+		auto mit = --info.end();
+		body["event_type"] = mit.key();
+		body["info"] = mit.value();
+	} else {
+		body["event_type"] = "none";
+	}
+
+	std::vector<uint8_t> bodyPacked = json::to_msgpack(body);
+	// LOG(INFO) << "body: " << body;
+	return std::string(bodyPacked.begin(), bodyPacked.end());
+}
+
 void Dummy::sender() {
 	pthread_setname_np(pthread_self(), (mName + ":sender").c_str());
-	while (mSend.test()) {
+	Trace::thread(mName + ":sender");
+	mThread.apply(mName + ":sender");
+	// Once stopped, queued events still go out but failed ones are not retried
+	while (mSend.test() || mSendQueue.size() > 0) {
 		if (mSendQueue.ready()) {
-			Slot& slot = mSendQueue.first();
-			if (send(slot)) {
+			Event& event = mSendQueue.first();
+			int64_t begin = Trace::now();
+			bool sent = send(event);
+			mSendTime->observe(Trace::now() - begin);
+			Trace::complete("send", begin, event.mStreamId, 0, event.mFrameNumber);
+			if (sent) {
 				mSendQueue.remove();
+				mFramesOut->add();
 			} else {
 				LOG(ERROR) << mName << ": Could not send event";
-				if (mResendInterval > 0) {
+				mSendErrors->add();
+				if (mResendInterval > 0 && mSend.test()) {
 					std::this_thread::sleep_for(std::chrono::seconds(mResendInterval));
 				} else {
 					mSendQueue.remove();
 				}
 			}
+			mSendQueueDepth->set(mSendQueue.size());
 		}
 	}
 }
 
+Dummy::Event::Event(Event&& other) noexcept :
+	mStreamId(other.mStreamId),
+	mStreamName(std::move(other.mStreamName)),
+	mInfo(std::move(other.mInfo)),
+	mFrameNumber(other.mFrameNumber),
+	mDts(other.mDts),
+	mPts(other.mPts),
+	mFrameSize(other.mFrameSize),
+	mWidth(other.mWidth),
+	mHeight(other.mHeight),
+	mCaptured(other.mCaptured),
+	mPicture(std::exchange(other.mPicture, nullptr)) {
+}
+
+Dummy::Event::~Event() {
+	av_packet_free(&mPicture);
+}
+
 }
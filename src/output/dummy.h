@@ -3,6 +3,8 @@
 #include "module.h"
 
 #include <map>
+#include <set>
+#include <deque>
 #include <atomic>
 
 #include "queue.h"
@@ -16,31 +18,62 @@ public:
 	Dummy(const json& config,
 	      size_t id,
 	      std::vector<std::vector<Slot>>& slot,
-	      Queue<uint32_t>& queue);
+	      Queue<Handle>& queue);
 	Dummy(const Dummy& other) = delete;
 	Dummy(Dummy&& other) noexcept;
 	virtual ~Dummy();
 
 	static bool validate(const json& config);
 
+	// Called by the pipeline once every frame of a segment input has passed
+	void finish(uint16_t streamId);
+
 protected:
+	// What the sender needs of an event, the picture is encoded before the slot goes back to the input
+	struct Event {
+		size_t mStreamId = 0;
+		std::string mStreamName;
+		json mInfo;
+		int mFrameNumber = 0;
+		int64_t mDts = 0;
+		int64_t mPts = 0;
+		int mFrameSize = 0;
+		int mWidth = 0;
+		int mHeight = 0;
+		std::chrono::steady_clock::time_point mCaptured;
+		AVPacket* mPicture = NULL;
+
+		Event() = default;
+		Event(const Event& other) = delete;
+		Event(Event&& other) noexcept;
+		~Event();
+	};
+
 	void task() override;
 	bool start() override;
 	void stop() override;
-	virtual bool send(Slot& slot);
+	virtual bool send(Event& event);
 
 	std::string timestampNow();
 
 	const AVPacket* packet(Slot& slot, AVCodecID format);
+	virtual bool event(Slot& slot, Event& event);
+	std::string body(const AVPacket* picture, const json& info);
 
 	bool mLocalTime = true;
 	size_t mResendInterval = 0;
+	size_t mExpired = 0;
+
+	Metrics::Histogram* mEncodeTime = nullptr;
+	Metrics::Histogram* mSendTime = nullptr;
+	Metrics::Gauge* mSendQueueDepth = nullptr;
+	Metrics::Counter* mSendErrors = nullptr;
 
 private:
 	std::vector<std::vector<Slot>>& mSlot;
-	Queue<uint32_t>& mQueue;
+	Queue<Handle>& mQueue;
 
-	Queue<Slot> mSendQueue;
+	Queue<Event> mSendQueue;
 	std::thread mSender;
 
 	void sender();
@@ -60,6 +93,21 @@ private:
 
 	std::map<size_t, Packet> mPacket;
 
+	// Segments of one file run in parallel, events of a segment wait for the earlier ones to finish
+	struct Segments {
+		std::vector<uint16_t> mStream;
+		size_t mHead = 0;
+	};
+
+	void release();
+	void hand(uint16_t streamId);
+
+	std::vector<Segments> mSegments;
+	std::map<uint16_t, std::pair<size_t, size_t>> mSegmentOf;
+	std::map<uint16_t, std::deque<Event>> mHeld;
+	std::set<uint16_t> mDone;
+	Queue<uint16_t> mFinished;
+
 };
 
 }
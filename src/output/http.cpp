@@ -10,7 +10,7 @@ namespace Sight::Output {
 Http::Http(const json& config,
            size_t id,
            std::vector<std::vector<Slot>>& slot,
-           Queue<uint32_t>& queue) :
+           Queue<Handle>& queue) :
 	Dummy(config, id, slot, queue) {
 	mUrl = config["url"];
 	mToken = config["token"];
@@ -46,59 +46,26 @@ bool Http::validate(const json& config) {
 	return true;
 }
 
-bool Http::send(Slot& slot) {
-	const AVFrame* frame = slot.frame();
-	if (frame == nullptr) {
-		LOG(ERROR) << mName << ": Error encodind frame";
-		return true;
-	}
-
-	const AVPacket* picture = packet(slot, AV_CODEC_ID_MJPEG);
-	if (picture == nullptr) {
-		LOG(ERROR) << mName << ": Error encodind packet";
-		return true;
-	}
-
-	auto& info = slot.info();
+bool Http::send(Event& event) {
+	const AVPacket* picture = event.mPicture;
+	auto& info = event.mInfo;
 
 	LOG(INFO) << mName
-	          << ": Event stream name = " << slot.streamName()
+	          << ": Event stream name = " << event.mStreamName
 	          << ", timestamp = " << timestampNow()
-	          << ", frame number = " << frame->coded_picture_number
-	          << ", frame dts = " << frame->pkt_dts
-	          << ", frame pts = " << frame->pts
-	          << ", frame size = " << frame->pkt_size
-	          << ", frame width = " << frame->width
-	          << ", frame height = " << frame->height
+	          << ", frame number = " << event.mFrameNumber
+	          << ", frame dts = " << event.mDts
+	          << ", frame pts = " << event.mPts
+	          << ", frame size = " << event.mFrameSize
+	          << ", frame width = " << event.mWidth
+	          << ", frame height = " << event.mHeight
 	          << ", packet pts: " << picture->pts
 	          << ", packet dts: " << picture->dts
 	          << ", packet size: " << picture->size
 	          << ", stream index: " << picture->stream_index
 	          << ", info = " << info.dump();
 
-	std::vector<uint8_t> image;
-	image.assign(picture->data, picture->data + picture->size);
-
-	json body;
-	body["timestamp"] = timestampNow();
-
-	body["files"] = json::array();
-	body["files"].push_back(json::object());
-	body["files"].back()["file"] = json::binary(image);
-	body["files"].back()["is_main"] = true;
-	body["files"].back()["format"] = "jpg";
-
-	auto mit = info.end();
-	if (--mit != info.end()) {
-		body["event_type"] = mit.key();
-		body["info"] = mit.value();
-	} else {
-		body["event_type"] = "none";
-	}
-
-	std::vector<uint8_t> bodyPacked = json::to_msgpack(body);
-	// LOG(INFO) << "body: " << body;
-	std::string str(bodyPacked.begin(), bodyPacked.end());
+	std::string str = body(picture, info);
 
 	httplib::Client cli(mUrl.c_str());
 	// cli.set_connection_timeout(0, 2000000); // 1 seconds
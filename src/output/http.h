@@ -10,7 +10,7 @@ public:
 	Http(const json& config,
 	     size_t id,
 	     std::vector<std::vector<Slot>>& slot,
-	     Queue<uint32_t>& queue);
+	     Queue<Handle>& queue);
 	Http(const Http& other) = delete;
 	Http(Http&& other) noexcept;
 	~Http();
@@ -18,7 +18,7 @@ public:
 	static bool validate(const json& config);
 
 protected:
-	bool send(Slot& slot) override;
+	bool send(Event& event) override;
 
 private:
 	std::string mUrl;
@@ -1,5 +1,7 @@
 #include "pipeline.h"
 
+#include <algorithm>
+#include <map>
 #include <set>
 
 #include <glog/logging.h>
@@ -7,9 +9,30 @@
 #ifdef INPUT_STREAM
 #	include "input/stream.h"
 #endif
+#ifdef INPUT_SYNTHETIC
+#	include "input/synthetic.h"
+#endif
+#ifdef INPUT_REPLAY
+#	include "input/replay.h"
+#endif
+#ifdef INPUT_CACHE
+#	include "input/cache.h"
+#endif
+#ifdef INPUT_FILE
+#	include "input/file.h"
+#endif
+#ifdef INPUT_IMAGES
+#	include "input/images.h"
+#endif
+#ifdef INPUT_RAW
+#	include "input/raw.h"
+#endif
 #ifdef PROCESSING_DETECT
 #	include "processing/detect.h"
 #endif
+#ifdef PROCESSING_TRACK
+#	include "processing/track.h"
+#endif
 #ifdef OUTPUT_DISK
 #	include "output/disk.h"
 #endif
@@ -19,47 +42,97 @@
 
 namespace Sight {
 
-Pipeline::Pipeline(const json& config, size_t id) :
-	Module(config, id) {
-	// Create slots
-	mSlot.reserve(config["input"].size());
-	for (size_t id = 0; id < config["input"].size(); ++id) {
-		mSlot.push_back(std::vector<Slot>());
-		std::string streamName = config["input"][id]["name"];
-		size_t slotCount = slotSize(config, config["input"][id]);
-		size_t stages = stageCount(config, config["input"][id]);
-		mSlot[id].reserve(slotCount + 1);
-		for (size_t slotId = 0; slotId < slotCount + 1; ++slotId) {
-			mSlot[id].push_back(Slot(id, streamName, stages));
+namespace {
+
+// Empty rings kept for inputs a reload adds, the stages index the ring vector so it never grows
+constexpr size_t kSpareInputs = 16;
+
+// Thread settings of a module over the defaults of its pipeline
+json threadOf(const json& defaults, const json& module) {
+	json result = defaults;
+	if (module.contains("thread") && module["thread"].is_object()) {
+		result.update(module["thread"]);
+	}
+	return result;
+}
+
+// Concat streams and roi areas name inputs, an expanded input is referenced by the names it became
+void renameStream(json& processing, const std::string& name, const std::vector<std::string>& names) {
+	if (!processing.is_object()) {
+		return;
+	}
+	if (processing.contains("concat") && processing["concat"].is_object() &&
+	    processing["concat"].contains("streams") && processing["concat"]["streams"].is_array()) {
+		json streams = json::array();
+		for (auto& stream : processing["concat"]["streams"]) {
+			if (stream == name) {
+				for (auto& renamed : names) {
+					streams.push_back(renamed);
+				}
+			} else {
+				streams.push_back(stream);
+			}
 		}
+		processing["concat"]["streams"] = streams;
 	}
+	if (processing.contains("roi") && processing["roi"].is_array()) {
+		json roi = json::array();
+		for (auto& area : processing["roi"]) {
+			if (area.is_object() && area.contains("stream") && area["stream"] == name) {
+				for (auto& renamed : names) {
+					json a = area;
+					a["stream"] = renamed;
+					roi.push_back(a);
+				}
+			} else {
+				roi.push_back(area);
+			}
+		}
+		processing["roi"] = roi;
+	}
+}
+
+}
+
+Pipeline::Pipeline(const json& config, size_t id) :
+	Module(config, id),
+	mConfig(config) {
+	// Latency budget applies to live streams only, offline frames are never late
+	if (config.contains("latency")) {
+		mLatency = std::chrono::milliseconds(config["latency"].get<uint64_t>());
+	}
+
+	// Thread settings of the pipeline are defaults for its modules, automatic placement spreads pipelines over nodes
+	mDefaults = config.value("thread", json::object());
+	if (mDefaults.value("placement", "none") == "node" && !mDefaults.contains("cpus") && !mDefaults.contains("node")) {
+		mDefaults["node"] = mId % Thread::nodes();
+		LOG(INFO) << mName << ": Placed on NUMA node " << mDefaults["node"];
+	}
+	mDefaults.erase("placement");
+
+	Graph graph(config);
 
 	// Create queues
 	size_t queueCount = config["processing"].size() + config["output"].size();
 	mQueue.reserve(queueCount);
 	for (size_t id = 0; id < queueCount; ++id) {
-		mQueue.push_back(Queue<uint32_t>());
+		mQueue.push_back(Queue<Handle>());
 	}
 
-	// Create inputs
-	mInput.reserve(config["input"].size());
+	// Create slots and inputs
+	mSlot.resize(config["input"].size() + kSpareInputs);
+	mInput.reserve(mSlot.size());
 	for (size_t id = 0; id < config["input"].size(); ++id) {
-		auto& input = config["input"][id];
-		std::vector<size_t> queueId(queueIds(config, input));
-		if (input["type"] == "dummy") {
-			mInput.push_back(std::make_unique<Input::Dummy>(input, id, mSlot[id], mQueue, queueId));
-#ifdef INPUT_STREAM
-		} else if (input["type"] == "stream") {
-			mInput.push_back(std::make_unique<Input::Stream>(input, id, mSlot[id], mQueue, queueId));
-#endif
-		}
+		add(config["input"][id], graph, id);
 	}
 
 	// Create processors
 	mProcessing.reserve(config["processing"].size());
 	for (size_t id = 0; id < config["processing"].size(); ++id) {
-		auto& processing = config["processing"][id];
-		std::vector<size_t> queueId(queueIds(config, processing));
+		json processing = config["processing"][id];
+		processing["pipeline"] = mName;
+		processing["thread"] = threadOf(mDefaults, processing);
+		std::vector<size_t> queueId(graph.queueIds(graph.node(Graph::Kind::processing, id)));
 		if (processing["type"] == "dummy") {
 			mProcessing.push_back(std::make_unique<Processing::Dummy>
 			                      (processing, id, mSlot, mQueue[config["output"].size() + id], mQueue, queueId));
@@ -68,13 +141,43 @@ Pipeline::Pipeline(const json& config, size_t id) :
 			mProcessing.push_back(std::make_unique<Processing::Detect>
 			                      (processing, id, mSlot, mQueue[config["output"].size() + id], mQueue, queueId));
 #endif
+#ifdef PROCESSING_TRACK
+		} else if (processing["type"] == "track") {
+			mProcessing.push_back(std::make_unique<Processing::Track>
+			                      (processing, id, mSlot, mQueue[config["output"].size() + id], mQueue, queueId));
+#endif
+		}
+	}
+
+	// Segments of one file in order, outputs hold back events of a segment until the earlier ones are done
+	std::map<std::string, json> groups;
+	for (size_t id = 0; id < config["input"].size(); ++id) {
+		auto& input = config["input"][id];
+		if (input.contains("segment")) {
+			auto& group = groups[input["segment"]["group"]];
+			if (group.is_null()) {
+				group = json::array();
+				for (size_t index = 0; index < input["segment"]["count"]; ++index) {
+					group.push_back(nullptr);
+				}
+			}
+			group[input["segment"]["index"].get<size_t>()] = id;
 		}
 	}
+	json segments = json::array();
+	for (auto& [name, group] : groups) {
+		segments.push_back(group);
+	}
 
 	// Create optputs
 	mOutput.reserve(config["output"].size());
 	for (size_t id = 0; id < config["output"].size(); ++id) {
-		auto& output = config["output"][id];
+		json output = config["output"][id];
+		output["pipeline"] = mName;
+		output["thread"] = threadOf(mDefaults, output);
+		if (!segments.empty()) {
+			output["segments"] = segments;
+		}
 		if (output["type"] == "dummy") {
 			mOutput.push_back(std::make_unique<Output::Dummy>(output, id, mSlot, mQueue[id]));
 #ifdef OUTPUT_DISK
@@ -91,11 +194,84 @@ Pipeline::Pipeline(const json& config, size_t id) :
 
 Pipeline::Pipeline(Pipeline&& other) noexcept :
 	Module(std::move(other)),
+	mConfig(std::move(other.mConfig)),
+	mDefaults(std::move(other.mDefaults)),
+	mLatency(other.mLatency),
 	mSlot(std::move(other.mSlot)),
 	mQueue(std::move(other.mQueue)),
 	mInput(std::move(other.mInput)),
 	mProcessing(std::move(other.mProcessing)),
-	mOutput(std::move(other.mOutput)) {
+	mOutput(std::move(other.mOutput)),
+	mStream(std::move(other.mStream)),
+	mSegment(std::move(other.mSegment)),
+	mSegmentDone(std::move(other.mSegmentDone)) {
+}
+
+void Pipeline::add(const json& config, const Graph& graph, size_t index) {
+	size_t id = mInput.size();
+	std::string streamName = config["name"];
+	size_t slotCount = graph.slotSize(graph.node(Graph::Kind::input, index)) + 1;
+	size_t stages = graph.stageCount(graph.node(Graph::Kind::input, index));
+	bool live = config["live"];
+
+	// Ring is allocated at its largest, stages index it while the input grows and shrinks it
+	size_t slotMin = slotCount;
+	size_t slotMax = slotCount;
+	if (config.contains("slots")) {
+		auto& slots = config["slots"];
+		slotMin = slots.contains("min") ? slots["min"].get<size_t>() : slotCount;
+		slotMax = slots.contains("max") ? slots["max"].get<size_t>() : std::max(slotMin, slotCount);
+		slotMin = std::min(slotMin, slotMax);
+	}
+	mSlot[id].reserve(slotMax);
+	int node = threadOf(mDefaults, config).value("node", -1);
+	for (size_t slotId = 0; slotId < slotMax; ++slotId) {
+		mSlot[id].push_back(Slot(id, streamName, stages, live ? mLatency : std::chrono::milliseconds(0)));
+		mSlot[id].back().place(node);
+	}
+
+	json input = config;
+	input["pipeline"] = mName;
+	input["thread"] = threadOf(mDefaults, input);
+	input["slots"]["min"] = slotMin;
+	std::vector<size_t> queueId(graph.queueIds(graph.node(Graph::Kind::input, index)));
+	if (input["type"] == "dummy") {
+		mInput.push_back(std::make_unique<Input::Dummy>(input, id, mSlot[id], mQueue, queueId));
+#ifdef INPUT_STREAM
+	} else if (input["type"] == "stream") {
+		mInput.push_back(std::make_unique<Input::Stream>(input, id, mSlot[id], mQueue, queueId));
+#endif
+#ifdef INPUT_SYNTHETIC
+	} else if (input["type"] == "synthetic") {
+		mInput.push_back(std::make_unique<Input::Synthetic>(input, id, mSlot[id], mQueue, queueId));
+#endif
+#ifdef INPUT_REPLAY
+	} else if (input["type"] == "replay") {
+		mInput.push_back(std::make_unique<Input::Replay>(input, id, mSlot[id], mQueue, queueId));
+#endif
+#ifdef INPUT_CACHE
+	} else if (input["type"] == "cache") {
+		mInput.push_back(std::make_unique<Input::Cache>(input, id, mSlot[id], mQueue, queueId));
+#endif
+#ifdef INPUT_FILE
+	} else if (input["type"] == "file") {
+		mInput.push_back(std::make_unique<Input::File>(input, id, mSlot[id], mQueue, queueId));
+#endif
+#ifdef INPUT_IMAGES
+	} else if (input["type"] == "images") {
+		mInput.push_back(std::make_unique<Input::Images>(input, id, mSlot[id], mQueue, queueId));
+#endif
+#ifdef INPUT_RAW
+	} else if (input["type"] == "raw") {
+		mInput.push_back(std::make_unique<Input::Raw>(input, id, mSlot[id], mQueue, queueId));
+#endif
+	} else {
+		mInput.push_back(nullptr);
+	}
+	mStream[streamName] = id;
+	if (config.contains("segment")) {
+		mSegment.insert(id);
+	}
 }
 
 Pipeline::~Pipeline() {
@@ -107,10 +283,125 @@ Pipeline::~Pipeline() {
 	mSlot.clear();
 }
 
+json Pipeline::expand(const json& config) {
+	if (!config.contains("input") || !config["input"].is_array()) {
+		return config;
+	}
+
+	// Inputs with copies become that many inputs with numbered names
+	json result = config;
+	result["input"] = json::array();
+	for (auto& input : config["input"]) {
+		if (input.is_object() && input.contains("copies") && input["copies"].is_number_unsigned() &&
+		    input.contains("name") && input["name"].is_string()) {
+			std::string name = input["name"];
+			size_t copies = input["copies"];
+			std::vector<std::string> names;
+			for (size_t copy = 0; copy < copies; ++copy) {
+				json c = input;
+				c.erase("copies");
+				c["name"] = name + "-" + std::to_string(copy);
+				names.push_back(c["name"]);
+				// Copies exist to add load, a shared source would decode them once
+				if (!c.contains("shared")) {
+					c["shared"] = false;
+				}
+				result["input"].push_back(c);
+			}
+			if (result.contains("processing") && result["processing"].is_array()) {
+				for (auto& processing : result["processing"]) {
+					renameStream(processing, name, names);
+				}
+			}
+		} else {
+			result["input"].push_back(input);
+		}
+	}
+
+	// Offline inputs with segments become one input per segment, each with its own copy of the processing behind it
+	json inputs = result["input"];
+	result["input"] = json::array();
+	for (auto& input : inputs) {
+		if (!input.is_object() || !input.contains("segments") || !input["segments"].is_number_unsigned() ||
+		    input["segments"] == 0 || !input.contains("live") || input["live"] != false ||
+		    !input.contains("name") || !input["name"].is_string() || !input.contains("out") || !input["out"].is_array() ||
+		    !result.contains("processing") || !result["processing"].is_array()) {
+			result["input"].push_back(input);
+			continue;
+		}
+		std::string name = input["name"];
+		size_t count = input["segments"];
+
+		// Processing reachable from the input is cloned, outputs are shared and merge the segments
+		std::set<std::string> reachable;
+		std::vector<json> pending(input["out"].begin(), input["out"].end());
+		while (!pending.empty()) {
+			json next = pending.back();
+			pending.pop_back();
+			for (auto& processing : result["processing"]) {
+				if (processing.is_object() && processing.contains("name") && processing["name"] == next &&
+				    next.is_string() && !reachable.contains(next)) {
+					reachable.insert(next);
+					if (processing.contains("out") && processing["out"].is_array()) {
+						pending.insert(pending.end(), processing["out"].begin(), processing["out"].end());
+					}
+				}
+			}
+		}
+		auto rename = [&reachable](const json& out, size_t index) {
+			json renamed = json::array();
+			for (auto& target : out) {
+				if (target.is_string() && reachable.contains(target)) {
+					renamed.push_back(target.get<std::string>() + "#" + std::to_string(index));
+				} else {
+					renamed.push_back(target);
+				}
+			}
+			return renamed;
+		};
+
+		std::vector<std::string> names;
+		for (size_t index = 0; index < count; ++index) {
+			json c = input;
+			c.erase("segments");
+			c["name"] = name + "#" + std::to_string(index);
+			names.push_back(c["name"]);
+			c["segment"] = {{"group", name}, {"index", index}, {"count", count}};
+			c["out"] = rename(input["out"], index);
+			result["input"].push_back(c);
+		}
+
+		json processings = json::array();
+		for (auto& processing : result["processing"]) {
+			if (!processing.is_object() || !processing.contains("name") || !reachable.contains(processing["name"])) {
+				json c = processing;
+				renameStream(c, name, names);
+				processings.push_back(c);
+				continue;
+			}
+			for (size_t index = 0; index < count; ++index) {
+				json c = processing;
+				c["name"] = processing["name"].get<std::string>() + "#" + std::to_string(index);
+				renameStream(c, name, {names[index]});
+				if (processing.contains("out") && processing["out"].is_array()) {
+					c["out"] = rename(processing["out"], index);
+				}
+				processings.push_back(c);
+			}
+		}
+		result["processing"] = processings;
+	}
+	return result;
+}
+
 bool Pipeline::validate(const json& config) {
 	if (!Module::validate(config)) {
 		return false;
 	}
+	if (config.contains("latency") && !config["latency"].is_number_unsigned()) {
+		LOG(ERROR) << "Latency is not unsigned number";
+		return false;
+	}
 
 	// Validate inputs
 	std::set<std::string> inputUnique;
@@ -138,6 +429,42 @@ bool Pipeline::validate(const json& config) {
 			if (!Input::Stream::validate(input)) {
 				return false;
 			}
+#endif
+#ifdef INPUT_SYNTHETIC
+		} else if (input["type"] == "synthetic") {
+			if (!Input::Synthetic::validate(input)) {
+				return false;
+			}
+#endif
+#ifdef INPUT_REPLAY
+		} else if (input["type"] == "replay") {
+			if (!Input::Replay::validate(input)) {
+				return false;
+			}
+#endif
+#ifdef INPUT_CACHE
+		} else if (input["type"] == "cache") {
+			if (!Input::Cache::validate(input)) {
+				return false;
+			}
+#endif
+#ifdef INPUT_FILE
+		} else if (input["type"] == "file") {
+			if (!Input::File::validate(input)) {
+				return false;
+			}
+#endif
+#ifdef INPUT_IMAGES
+		} else if (input["type"] == "images") {
+			if (!Input::Images::validate(input)) {
+				return false;
+			}
+#endif
+#ifdef INPUT_RAW
+		} else if (input["type"] == "raw") {
+			if (!Input::Raw::validate(input)) {
+				return false;
+			}
 #endif
 		} else {
 			LOG(ERROR) << "Unknown input type = " << input["type"];
@@ -180,6 +507,12 @@ bool Pipeline::validate(const json& config) {
 			if (!Processing::Detect::validate(processing)) {
 				return false;
 			}
+#endif
+#ifdef PROCESSING_TRACK
+		} else if (processing["type"] == "track") {
+			if (!Processing::Track::validate(processing)) {
+				return false;
+			}
 #endif
 		} else {
 			LOG(ERROR) << "Unknown processing type = " << processing["type"];
@@ -293,8 +626,137 @@ bool Pipeline::validate(const json& config) {
 		return false;
 	}
 
-	// TODO: Detect cycles
+	// Validate that concat streams are inputs
+	for (size_t id = 0; id < config["processing"].size(); ++id) {
+		auto& processing = config["processing"][id];
+		if (processing.contains("concat") && processing["concat"].contains("streams")) {
+			for (auto& stream : processing["concat"]["streams"]) {
+				if (!inputUnique.contains(stream)) {
+					LOG(ERROR) << "Concat stream is not an input = " << stream
+					           << ", processing = " << processing["name"];
+					return false;
+				}
+			}
+		}
+	}
+
+	// Module thread settings are only complete over the pipeline defaults, which also run its own thread
+	json thread = config.value("thread", json::object());
+	if (!Thread::validate(thread)) {
+		return false;
+	}
+	for (auto& section : {"input", "processing", "output"}) {
+		for (auto& module : config[section]) {
+			if (!Thread::validate(threadOf(thread, module))) {
+				LOG(ERROR) << "Incorrect thread settings, module = " << module["name"];
+				return false;
+			}
+		}
+	}
+
+	// Validate that frames can not come back to a node
+	Graph graph(config);
+	if (!graph.acyclic()) {
+		std::string path;
+		for (auto& name : graph.cycle()) {
+			path += path.empty() ? name : " -> " + name;
+		}
+		LOG(ERROR) << "Pipeline has a cycle = " << path;
+		return false;
+	}
+
+	return true;
+}
+
+const json& Pipeline::config() const {
+	return mConfig;
+}
+
+bool Pipeline::reconfigure(const json& config) {
+	if (!config.contains("processing") || config["processing"].size() != mConfig["processing"].size()) {
+		return false;
+	}
+
+	// Anything but inputs and processing delay and drop changes the graph or the decoders
+	auto stable = [](json c) {
+		c.erase("input");
+		for (auto& processing : c["processing"]) {
+			processing.erase("delay");
+			processing.erase("drop");
+		}
+		return c;
+	};
+	if (stable(config) != stable(mConfig)) {
+		return false;
+	}
+
+	// Inputs with an unchanged config keep running, a changed one is removed and added again
+	std::vector<std::string> removed;
+	std::vector<size_t> added;
+	for (auto& input : mConfig["input"]) {
+		if (std::find(config["input"].begin(), config["input"].end(), input) == config["input"].end()) {
+			removed.push_back(input["name"]);
+		}
+	}
+	for (size_t index = 0; index < config["input"].size(); ++index) {
+		auto& input = config["input"][index];
+		if (std::find(mConfig["input"].begin(), mConfig["input"].end(), input) == mConfig["input"].end()) {
+			added.push_back(index);
+		}
+	}
+
+	if (!removed.empty() || !added.empty()) {
+		// Concat groups and segment order are fixed when the stages are built
+		for (auto& processing : config["processing"]) {
+			if (processing.contains("concat")) {
+				return false;
+			}
+		}
+		for (auto& name : removed) {
+			if (mSegment.contains(mStream[name])) {
+				return false;
+			}
+		}
+		for (auto& index : added) {
+			if (config["input"][index].contains("segment")) {
+				return false;
+			}
+		}
+		if (mInput.size() + added.size() > mSlot.size()) {
+			return false;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mLock);
+	for (auto& name : removed) {
+		LOG(INFO) << mName << ": Remove input " << name;
+		// Its ring stays, frames still in the stages reference it
+		auto& input = mInput[mStream[name]];
+		if (input) {
+			input->terminate();
+			input->wait();
+			input.reset();
+		}
+		mStream.erase(name);
+	}
+	if (!added.empty()) {
+		Graph graph(config);
+		for (auto& index : added) {
+			LOG(INFO) << mName << ": Add input " << config["input"][index]["name"];
+			add(config["input"][index], graph, index);
+			if (running() && mInput.back()) {
+				mInput.back()->run();
+			}
+		}
+	}
 
+	for (size_t id = 0; id < mProcessing.size(); ++id) {
+		if (config["processing"][id] != mConfig["processing"][id]) {
+			LOG(INFO) << mName << ": Reconfigure " << mProcessing[id]->name();
+			mProcessing[id]->reconfigure(config["processing"][id]);
+		}
+	}
+	mConfig = config;
 	return true;
 }
 
@@ -307,19 +769,29 @@ bool Pipeline::start() {
 		processing->run();
 	}
 
+	std::lock_guard<std::mutex> lock(mLock);
 	for (auto& input : mInput) {
-		input->run();
+		if (input) {
+			input->run();
+		}
 	}
 
 	return true;
 }
 
 void Pipeline::stop() {
-	for (auto& input : mInput) {
-		input->terminate();
-	}
-	for (auto& input : mInput) {
-		input->wait();
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		for (auto& input : mInput) {
+			if (input) {
+				input->terminate();
+			}
+		}
+		for (auto& input : mInput) {
+			if (input) {
+				input->wait();
+			}
+		}
 	}
 
 	for (auto& processing : mProcessing) {
@@ -340,81 +812,26 @@ void Pipeline::stop() {
 void Pipeline::task() {
 	std::this_thread::sleep_for(std::chrono::milliseconds(500));
 
+	std::lock_guard<std::mutex> lock(mLock);
 	size_t finished = 0;
-	for (auto& input : mInput) {
-		if (!input->running()) {
-			++finished;
+	for (size_t id = 0; id < mInput.size(); ++id) {
+		if (mInput[id] && mInput[id]->running()) {
+			continue;
 		}
-	}
-	if (finished == mInput.size()) {
-		deactivate();
-	}
-}
-
-size_t Pipeline::slotSize(const json& config, const json& node) {
-	size_t count = 0;
-	for (size_t outId = 0; outId < node["out"].size(); ++outId) {
-		auto& name = node["out"][outId];
-		for (size_t id = 0; id < config["output"].size(); ++id) {
-			auto& output = config["output"][id];
-			if (output["name"] == name) {
-				count = 1;
-				break;
-			}
-		}
-		for (size_t id = 0; id < config["processing"].size(); ++id) {
-			auto& processor = config["processing"][id];
-			if (processor["name"] == name) {
-				size_t path = slotSize(config, processor) + 1;
-				if (path > count) {
-					count = path;
-				}
+		++finished;
+
+		// A segment is done once its last frame has left every stage
+		if (mSegment.contains(id) && !mSegmentDone.contains(id) &&
+		    std::all_of(mSlot[id].begin(), mSlot[id].end(), [](const Slot& slot) { return slot.ready(); })) {
+			mSegmentDone.insert(id);
+			for (auto& output : mOutput) {
+				output->finish(id);
 			}
 		}
 	}
-	return count;
-}
-
-size_t Pipeline::stageCount(const json& config, const json& node) {
-	size_t count = 0;
-	for (size_t outId = 0; outId < node["out"].size(); ++outId) {
-		auto& name = node["out"][outId];
-		for (size_t id = 0; id < config["processing"].size(); ++id) {
-			auto& processor = config["processing"][id];
-			if (processor["name"] == name) {
-				++count += stageCount(config, processor);
-				break;
-			}
-		}
-		for (size_t id = 0; id < config["output"].size(); ++id) {
-			auto& output = config["output"][id];
-			if (output["name"] == name) {
-				++count;
-				break;
-			}
-		}
-	}
-	return count;
-}
-
-std::vector<size_t> Pipeline::queueIds(const json& config, const json& node) {
-	std::vector<size_t> result;
-	for (size_t outId = 0; outId < node["out"].size(); ++outId) {
-		auto& outName = node["out"][outId];
-		for (size_t id = 0; id < config["output"].size(); ++id) {
-			auto& output = config["output"][id];
-			if (output["name"] == outName) {
-				result.push_back(id);
-			}
-		}
-		for (size_t id = 0; id < config["processing"].size(); ++id) {
-			auto& processor = config["processing"][id];
-			if (processor["name"] == outName) {
-				result.push_back(config["output"].size() + id);
-			}
-		}
+	if (finished == mInput.size()) {
+		deactivate();
 	}
-	return result;
 }
 
 }
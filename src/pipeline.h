@@ -3,8 +3,12 @@
 #include "module.h"
 
 #include <list>
+#include <map>
+#include <mutex>
+#include <set>
 #include <vector>
 
+#include "graph.h"
 #include "slot.h"
 #include "queue.h"
 
@@ -23,25 +27,43 @@ public:
 	Pipeline(Pipeline&& other) noexcept;
 	~Pipeline();
 
+	static json expand(const json& config);
 	static bool validate(const json& config);
 
+	const json& config() const;
+	bool reconfigure(const json& config);
+
 protected:
 	bool start() override;
 	void stop() override;
 	void task() override;
 
-	static size_t slotSize(const json& config, const json& node);
-	static size_t stageCount(const json& config, const json& node);
-	static std::vector<size_t> queueIds(const json& config, const json& node);
-
 private:
+	// Slot ring and module of an input at index in config, it takes the next stream id
+	void add(const json& config, const Graph& graph, size_t index);
+
+	json mConfig;
+	// Thread settings of the pipeline, defaults for its modules
+	json mDefaults;
+	std::chrono::milliseconds mLatency = std::chrono::milliseconds(0);
+
+	// One ring per stream id, spare empty ones at the end
 	std::vector<std::vector<Slot>> mSlot;
-	std::vector<Queue<uint32_t>> mQueue;
+	std::vector<Queue<Handle>> mQueue;
 
 	std::vector<std::unique_ptr<Input::Dummy>> mInput;
 	std::vector<std::unique_ptr<Processing::Dummy>> mProcessing;
 	std::vector<std::unique_ptr<Output::Dummy>> mOutput;
 
+	// Stream ids of the inputs by name, a removed input leaves its ring and an empty module behind
+	std::map<std::string, size_t> mStream;
+	// Guards the inputs against a reload
+	std::mutex mLock;
+
+	// Segment inputs and those whose frames have all been released
+	std::set<size_t> mSegment;
+	std::set<size_t> mSegmentDone;
+
 };
 
 }
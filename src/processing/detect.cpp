@@ -1,5 +1,7 @@
 #include "detect.h"
 
+#include <algorithm>
+
 #include <glog/logging.h>
 
 namespace Sight::Processing {
@@ -7,14 +9,34 @@ namespace Sight::Processing {
 Detect::Detect(const json& config,
                size_t id,
                std::vector<std::vector<Slot>>& slot,
-               Queue<uint32_t>& queueIn,
-               std::vector<Queue<uint32_t>>& queueOut,
+               Queue<Handle>& queueIn,
+               std::vector<Queue<Handle>>& queueOut,
                std::vector<size_t>& queueOutId) :
 	Dummy(config, id, slot, queueIn, queueOut, queueOutId) {
+	if (config.contains("tile")) {
+		auto& tile = config["tile"];
+		mRows = tile["rows"];
+		mCols = tile["cols"];
+		mOverlap = tile.value("overlap", 0.0);
+	}
+	if (config.contains("threshold")) {
+		mThreshold = config["threshold"];
+	}
+	if (config.contains("interval")) {
+		mInterval = config["interval"];
+	}
 }
 
 Detect::Detect(Detect&& other) noexcept :
-	Dummy(std::move(other)) {
+	Dummy(std::move(other)),
+	mWidth(std::exchange(other.mWidth, 0)),
+	mHeight(std::exchange(other.mHeight, 0)),
+	mRows(std::exchange(other.mRows, 1)),
+	mCols(std::exchange(other.mCols, 1)),
+	mOverlap(std::exchange(other.mOverlap, 0.0)),
+	mThreshold(std::exchange(other.mThreshold, 0.0)),
+	mInterval(std::exchange(other.mInterval, 1)),
+	mCounter(std::move(other.mCounter)) {
 }
 
 Detect::~Detect() {
@@ -24,19 +46,176 @@ bool Detect::validate(const json& config) {
 	if (!Dummy::validate(config)) {
 		return false;
 	}
+	if (config.contains("tile")) {
+		auto& tile = config["tile"];
+		if (!tile.is_object()) {
+			LOG(ERROR) << "Tile is not an object";
+			return false;
+		}
+		if (!tile.contains("rows") || !tile["rows"].is_number_unsigned() || tile["rows"] == 0 ||
+		    !tile.contains("cols") || !tile["cols"].is_number_unsigned() || tile["cols"] == 0) {
+			LOG(ERROR) << "Tile rows or cols are not exist or not positive numbers";
+			return false;
+		}
+		if (tile.contains("overlap") &&
+		    (!tile["overlap"].is_number() || tile["overlap"] < 0.0 || tile["overlap"] >= 1.0)) {
+			LOG(ERROR) << "Tile overlap is not a number in range [0, 1)";
+			return false;
+		}
+	}
+	if (config.contains("threshold") &&
+	    (!config["threshold"].is_number() || config["threshold"] < 0.0 || config["threshold"] > 1.0)) {
+		LOG(ERROR) << "Threshold is not a number in range [0, 1]";
+		return false;
+	}
+	if (config.contains("interval") && (!config["interval"].is_number_unsigned() || config["interval"] == 0)) {
+		LOG(ERROR) << "Interval is not positive number";
+		return false;
+	}
 	return true;
 }
 
 bool Detect::detect(Slot& slot) {
-	const AVFrame* frame = slot.frame(AV_PIX_FMT_RGB24, 416, 416);
-	if (frame == nullptr) {
-		return false;
+	const AVFrame* source = slot.source();
+
+	// Frames in between are left to the tracker
+	if (mInterval > 1 && mCounter[slot.streamId()]++ % mInterval != 0) {
+		auto& info = slot.info(mType);
+		info["id"] = source->coded_picture_number;
+		info["skipped"] = true;
+		return true;
+	}
+
+	Slot::Rect roi = region(slot);
+	Slot::Rect area = roi;
+	if (area.empty()) {
+		area = {0, 0, source->width, source->height};
+	}
+
+	// Tiles are cached by the slot, so other nodes asking the same crop reuse them
+	std::vector<Slot::Rect> rect = tiles(area);
+	std::vector<const AVFrame*> batch;
+	batch.reserve(rect.size());
+	for (auto& r : rect) {
+		const AVFrame* frame = slot.frame(r, AV_PIX_FMT_RGB24, mWidth, mHeight);
+		if (frame == nullptr) {
+			return false;
+		}
+		batch.push_back(frame);
+
+		// Boxes map back through the crop that was converted, it may start a chroma sample earlier
+		r = slot.align(r);
+		if (r.empty()) {
+			r = {0, 0, source->width, source->height};
+		}
+	}
+
+	// Map boxes back to the source frame
+	std::vector<std::vector<Object>> result = infer(batch);
+	std::vector<Object> objects;
+	for (size_t tileId = 0; tileId < result.size() && tileId < rect.size(); ++tileId) {
+		double scaleX = (double)rect[tileId].width / mWidth;
+		double scaleY = (double)rect[tileId].height / mHeight;
+		for (auto& object : result[tileId]) {
+			Object mapped = object;
+			mapped.mX = rect[tileId].x + object.mX * scaleX;
+			mapped.mY = rect[tileId].y + object.mY * scaleY;
+			mapped.mWidth = object.mWidth * scaleX;
+			mapped.mHeight = object.mHeight * scaleY;
+			double centerX = (mapped.mX + mapped.mWidth / 2.0) / source->width;
+			double centerY = (mapped.mY + mapped.mHeight / 2.0) / source->height;
+			if (inside(slot, centerX, centerY)) {
+				objects.push_back(mapped);
+			}
+		}
 	}
 
 	auto& info = slot.info(mType);
-	info["id"] = frame->coded_picture_number;
+	info["id"] = batch.front()->coded_picture_number;
+	if (!roi.empty()) {
+		info["roi"] = {{"x", roi.x}, {"y", roi.y}, {"width", roi.width}, {"height", roi.height}};
+	}
+	info["objects"] = json::array();
+	for (auto& object : suppress(objects)) {
+		info["objects"].push_back({
+			{"label", object.mLabel},
+			{"score", object.mScore},
+			{"x", object.mX},
+			{"y", object.mY},
+			{"width", object.mWidth},
+			{"height", object.mHeight}
+		});
+	}
 
 	return true;
 }
 
+std::vector<std::vector<Detect::Object>> Detect::infer(const std::vector<const AVFrame*>& batch) {
+	// No model is integrated yet
+	return std::vector<std::vector<Object>>(batch.size());
+}
+
+std::vector<Slot::Rect> Detect::tiles(const Slot::Rect& area) const {
+	std::vector<Slot::Rect> result;
+	if (mRows == 1 && mCols == 1) {
+		result.push_back(area);
+		return result;
+	}
+
+	// Neighbour tiles share overlap part of the tile size
+	double width = area.width / (mCols - (mCols - 1) * mOverlap);
+	double height = area.height / (mRows - (mRows - 1) * mOverlap);
+	double stepX = width * (1.0 - mOverlap);
+	double stepY = height * (1.0 - mOverlap);
+	result.reserve(mRows * mCols);
+	for (size_t row = 0; row < mRows; ++row) {
+		for (size_t col = 0; col < mCols; ++col) {
+			Slot::Rect rect;
+			rect.x = area.x + (int)(col * stepX);
+			rect.y = area.y + (int)(row * stepY);
+			// Last column and row reach the edge, truncation must not leave pixels uncovered
+			int right = col + 1 == mCols ? area.x + area.width : std::min(area.x + (int)(col * stepX + width), area.x + area.width);
+			int bottom = row + 1 == mRows ? area.y + area.height : std::min(area.y + (int)(row * stepY + height), area.y + area.height);
+			rect.width = right - rect.x;
+			rect.height = bottom - rect.y;
+			result.push_back(rect);
+		}
+	}
+	return result;
+}
+
+std::vector<Detect::Object> Detect::suppress(std::vector<Object>& objects) const {
+	std::sort(objects.begin(), objects.end(), [](const Object& a, const Object& b) {
+		return a.mScore > b.mScore;
+	});
+
+	// Greedy non maximum suppression, duplicates come from overlapping tiles
+	std::vector<Object> result;
+	for (auto& object : objects) {
+		bool keep = true;
+		for (auto& kept : result) {
+			if (kept.mLabel == object.mLabel && overlap(kept, object) > mThreshold) {
+				keep = false;
+				break;
+			}
+		}
+		if (keep) {
+			result.push_back(object);
+		}
+	}
+	return result;
+}
+
+double Detect::overlap(const Object& a, const Object& b) {
+	double left = std::max(a.mX, b.mX);
+	double top = std::max(a.mY, b.mY);
+	double right = std::min(a.mX + a.mWidth, b.mX + b.mWidth);
+	double bottom = std::min(a.mY + a.mHeight, b.mY + b.mHeight);
+	if (right <= left || bottom <= top) {
+		return 0.0;
+	}
+	double intersection = (right - left) * (bottom - top);
+	return intersection / (a.mWidth * a.mHeight + b.mWidth * b.mHeight - intersection);
+}
+
 }
@@ -10,8 +10,8 @@ public:
 	Detect(const json& config,
 	       size_t id,
 	       std::vector<std::vector<Slot>>& slot,
-	       Queue<uint32_t>& queueIn,
-	       std::vector<Queue<uint32_t>>& queueOut,
+	       Queue<Handle>& queueIn,
+	       std::vector<Queue<Handle>>& queueOut,
 	       std::vector<size_t>& queueOutId);
 	Detect(const Detect& other) = delete;
 	Detect(Detect&& other) noexcept;
@@ -20,8 +20,37 @@ public:
 	static bool validate(const json& config);
 
 protected:
+	using Dummy::detect;
 	bool detect(Slot& slot) override;
 
+	// Detected object, box is in pixels of the frame it was found on
+	struct Object {
+		std::string mLabel;
+		double mScore = 0.0;
+		double mX = 0.0;
+		double mY = 0.0;
+		double mWidth = 0.0;
+		double mHeight = 0.0;
+	};
+
+	virtual std::vector<std::vector<Object>> infer(const std::vector<const AVFrame*>& batch);
+
+	std::vector<Slot::Rect> tiles(const Slot::Rect& area) const;
+	std::vector<Object> suppress(std::vector<Object>& objects) const;
+	static double overlap(const Object& a, const Object& b);
+
+	int mWidth = 416;
+	int mHeight = 416;
+
+	size_t mRows = 1;
+	size_t mCols = 1;
+	double mOverlap = 0.0;
+	double mThreshold = 0.45;
+
+	// Run inference on every Nth frame of a stream
+	size_t mInterval = 1;
+	std::map<size_t, size_t> mCounter;
+
 };
 
 }
@@ -1,38 +1,84 @@
 #include "dummy.h"
 
 #include <set>
+#include <algorithm>
 
 #include <glog/logging.h>
 
+#include "trace.h"
+
 namespace Sight::Processing {
 
 Dummy::Dummy(const json& config,
              size_t id,
              std::vector<std::vector<Slot>>& slot,
-             Queue<uint32_t>& queueIn,
-             std::vector<Queue<uint32_t>>& queueOut,
+             Queue<Handle>& queueIn,
+             std::vector<Queue<Handle>>& queueOut,
              std::vector<size_t>& queueOutId) :
 	Module(config, id),
 	mSlot(slot),
 	mQueueIn(queueIn),
 	mQueueOut(queueOut),
 	mQueueOutId(queueOutId) {
-	if (config.contains("delay") && config["delay"].is_number()) {
-		mDelay = config["delay"];
+	mProcessTime = &Metrics::histogram("sight_process_seconds", "Time to process a frame", labels());
+	mQueueDepth = &Metrics::gauge("sight_queue_depth", "Frames waiting in the module queue", labels());
+	reconfigure(config);
+	if (config.contains("concat")) {
+		auto& concat = config["concat"];
+		mConcat = true;
+		mTolerance = concat.value("tolerance", 0) * 1000;
+		mDepth = concat.value("depth", mDepth);
+		if (concat.contains("streams")) {
+			mConcatStream = concat["streams"].get<std::vector<std::string>>();
+		}
 	}
-	if (config.contains("drop") && config["drop"].is_boolean()) {
-		mDrop = config["drop"];
+	if (config.contains("roi")) {
+		for (auto& area : config["roi"]) {
+			Roi roi;
+			if (area.contains("polygon")) {
+				double minX = 1.0, minY = 1.0, maxX = 0.0, maxY = 0.0;
+				for (auto& point : area["polygon"]) {
+					double x = point[0];
+					double y = point[1];
+					roi.mPolygon.push_back({x, y});
+					minX = std::min(minX, x);
+					minY = std::min(minY, y);
+					maxX = std::max(maxX, x);
+					maxY = std::max(maxY, y);
+				}
+				roi.mX = minX;
+				roi.mY = minY;
+				roi.mWidth = maxX - minX;
+				roi.mHeight = maxY - minY;
+			} else {
+				roi.mX = area["x"];
+				roi.mY = area["y"];
+				roi.mWidth = area["width"];
+				roi.mHeight = area["height"];
+			}
+			std::string stream = area.value("stream", "");
+			mRoi[stream] = roi;
+		}
 	}
 }
 
 Dummy::Dummy(Dummy&& other) noexcept :
 	Module(std::move(other)),
-	mDelay(std::exchange(other.mDelay, 0)),
-	mDrop(std::exchange(other.mDrop, false)),
+	mDelay(other.mDelay.exchange(0)),
+	mDrop(other.mDrop.exchange(false)),
+	mExpired(std::exchange(other.mExpired, 0)),
+	mProcessTime(other.mProcessTime),
+	mQueueDepth(other.mQueueDepth),
 	mSlot(other.mSlot),
 	mQueueIn(other.mQueueIn),
 	mQueueOut(other.mQueueOut),
-	mQueueOutId(other.mQueueOutId) {
+	mQueueOutId(other.mQueueOutId),
+	mConcat(std::exchange(other.mConcat, false)),
+	mTolerance(std::exchange(other.mTolerance, 0)),
+	mDepth(std::exchange(other.mDepth, 0)),
+	mConcatStream(std::move(other.mConcatStream)),
+	mPending(std::move(other.mPending)),
+	mRoi(std::move(other.mRoi)) {
 }
 
 Dummy::~Dummy() {
@@ -46,6 +92,36 @@ bool Dummy::validate(const json& config) {
 		LOG(ERROR) << "Drop time is not boolean";
 		return false;
 	}
+	if (config.contains("concat")) {
+		auto& concat = config["concat"];
+		if (!concat.is_object()) {
+			LOG(ERROR) << "Concat is not an object";
+			return false;
+		}
+		if (concat.contains("tolerance") && !concat["tolerance"].is_number_unsigned()) {
+			LOG(ERROR) << "Concat tolerance is not unsigned number";
+			return false;
+		}
+		if (concat.contains("depth") && (!concat["depth"].is_number_unsigned() || concat["depth"] == 0)) {
+			LOG(ERROR) << "Concat depth is not positive number";
+			return false;
+		}
+		if (concat.contains("streams")) {
+			if (!concat["streams"].is_array() || concat["streams"].size() < 2) {
+				LOG(ERROR) << "Concat streams is not array or has less than 2 streams";
+				return false;
+			}
+			for (auto& stream : concat["streams"]) {
+				if (!stream.is_string() || stream.empty()) {
+					LOG(ERROR) << "Concat stream is not string or empty";
+					return false;
+				}
+			}
+		}
+	}
+	if (config.contains("roi") && !validateRoi(config["roi"])) {
+		return false;
+	}
 	if (config.contains("out") && config["out"].is_array() && !config["out"].empty()) {
 		auto& out = config["out"];
 		std::set<std::string> outUnique;
@@ -70,30 +146,278 @@ bool Dummy::validate(const json& config) {
 	return true;
 }
 
+void Dummy::stop() {
+	// Release frames still waiting for a group
+	for (auto& [streamId, pending] : mPending) {
+		for (auto& slotId : pending) {
+			forward(streamId, slotId, false);
+		}
+		pending.clear();
+	}
+	if (mExpired > 0) {
+		LOG(WARNING) << mName << ": Skipped expired frames = " << mExpired;
+	}
+}
+
+void Dummy::reconfigure(const json& config) {
+	mDelay = config.contains("delay") && config["delay"].is_number() ? config["delay"].get<uint64_t>() : 0;
+	mDrop = config.contains("drop") && config["drop"].is_boolean() ? config["drop"].get<bool>() : false;
+}
+
 void Dummy::task() {
 	if (mQueueIn.ready()) {
 		uint16_t streamId = 0;
-		uint8_t slotId = 0;
+		uint16_t slotId = 0;
+		uint32_t generation = 0;
 		bool process = false;
-		unpack(mQueueIn.get(), streamId, slotId, process);
+		unpack(mQueueIn.get(), streamId, slotId, generation, process);
+		mQueueDepth->set(mQueueIn.size());
+		mFramesIn->add();
+
+		// Slot is reset only after every stage released it, another generation means a stage lost a reference
 		auto& slot = mSlot[streamId][slotId];
+		if (slot.generation() != generation) {
+			// Its reference belongs to an earlier frame, releasing it would cut short the current one
+			LOG(ERROR) << mName << ": Stale handle, stream = " << streamId << ", slot = " << slotId;
+			mFramesDropped->add();
+			return;
+		}
+
+		// Frame is past the latency budget, pass it on without work
+		Trace::instant("dequeue", streamId, slotId, slot.source()->coded_picture_number);
+		if (process && slot.expired()) {
+			++mExpired;
+			mFramesDropped->add();
+			process = false;
+		}
+
+		if (mConcat && process) {
+			if (mPending.empty()) {
+				for (size_t id = 0; id < mSlot.size(); ++id) {
+					// Rings kept for inputs added later are empty
+					if (mSlot[id].empty()) {
+						continue;
+					}
+					auto& name = mSlot[id].front().streamName();
+					if (mConcatStream.empty() ||
+					    std::find(mConcatStream.begin(), mConcatStream.end(), name) != mConcatStream.end()) {
+						mPending[id] = std::deque<uint16_t>();
+					}
+				}
+			}
+			if (mPending.contains(streamId)) {
+				concat(streamId, slotId);
+				return;
+			}
+		}
 		if (process) {
+			int64_t begin = Trace::now();
+			delay();
 			process = detect(slot);
+			mProcessTime->observe(Trace::now() - begin);
+			Trace::complete("process", begin, streamId, slotId, slot.source()->coded_picture_number);
+		}
+		forward(streamId, slotId, process);
+	}
+}
+
+void Dummy::forward(uint16_t streamId, uint16_t slotId, bool process) {
+	Trace::instant("enqueue", streamId, slotId, mSlot[streamId][slotId].source()->coded_picture_number);
+	if (process) {
+		mFramesOut->add();
+	}
+	for (auto& queueId : mQueueOutId) {
+		mQueueOut[queueId].put(pack(streamId, slotId, mSlot[streamId][slotId].generation(), process));
+		mQueueOut[queueId].notify();
+	}
+	mSlot[streamId][slotId].unref();
+}
+
+void Dummy::concat(uint16_t streamId, uint16_t slotId) {
+	// Holding too many frames would starve the stream of slots
+	auto& queue = mPending[streamId];
+	queue.push_back(slotId);
+	while (queue.size() > mDepth) {
+		forward(streamId, queue.front(), false);
+		queue.pop_front();
+	}
+
+	while (true) {
+		// Group is complete when every stream has a frame
+		int64_t newest = INT64_MIN;
+		for (auto& [id, pending] : mPending) {
+			if (pending.empty()) {
+				return;
+			}
+			newest = std::max(newest, mSlot[id][pending.front()].timestamp());
 		}
-		for (auto& queueId : mQueueOutId) {
-			mQueueOut[queueId].put(pack(streamId, slotId, process));
-			mQueueOut[queueId].notify();
+
+		// Frames too old to match the newest one will never be grouped, held ones may expire meanwhile
+		bool dropped = false;
+		for (auto& [id, pending] : mPending) {
+			while (!pending.empty() && mSlot[id][pending.front()].timestamp() < newest - mTolerance) {
+				forward(id, pending.front(), false);
+				pending.pop_front();
+				dropped = true;
+			}
+			while (!pending.empty() && mSlot[id][pending.front()].expired()) {
+				++mExpired;
+				mFramesDropped->add();
+				forward(id, pending.front(), false);
+				pending.pop_front();
+				dropped = true;
+			}
+		}
+		if (dropped) {
+			continue;
+		}
+
+		std::vector<Slot*> group;
+		group.reserve(mPending.size());
+		for (auto& [id, pending] : mPending) {
+			group.push_back(&mSlot[id][pending.front()]);
+		}
+		int64_t begin = Trace::now();
+		delay();
+		std::vector<bool> process = detect(group);
+		mProcessTime->observe(Trace::now() - begin);
+		for (auto& [id, pending] : mPending) {
+			Trace::complete("process", begin, id, pending.front(), mSlot[id][pending.front()].source()->coded_picture_number);
+		}
+		size_t member = 0;
+		for (auto& [id, pending] : mPending) {
+			forward(id, pending.front(), process[member++]);
+			pending.pop_front();
 		}
-		slot.unref();
 	}
 }
 
-bool Dummy::detect([[maybe_unused]]Slot& slot) {
-	// auto& info = slot.info(mType);
+bool Dummy::validateRoi(const json& config) {
+	if (!config.is_array() || config.empty()) {
+		LOG(ERROR) << "Roi is not array or empty";
+		return false;
+	}
+	auto normalized = [](const json& value) {
+		return value.is_number() && value >= 0.0 && value <= 1.0;
+	};
+	std::set<std::string> streamUnique;
+	for (auto& area : config) {
+		if (!area.is_object()) {
+			LOG(ERROR) << "Roi area is not an object";
+			return false;
+		}
+		if (area.contains("stream") && (!area["stream"].is_string() || area["stream"].empty())) {
+			LOG(ERROR) << "Roi stream is not string or empty";
+			return false;
+		}
+		std::string stream = area.value("stream", "");
+		if (!streamUnique.contains(stream)) {
+			streamUnique.insert(stream);
+		} else {
+			LOG(ERROR) << "Roi has duplicate areas for stream = " << stream;
+			return false;
+		}
+		if (area.contains("polygon")) {
+			if (!area["polygon"].is_array() || area["polygon"].size() < 3) {
+				LOG(ERROR) << "Roi polygon is not array or has less than 3 points";
+				return false;
+			}
+			for (auto& point : area["polygon"]) {
+				if (!point.is_array() || point.size() != 2 ||
+				    !normalized(point[0]) || !normalized(point[1])) {
+					LOG(ERROR) << "Roi polygon point is not a pair of numbers in range [0, 1]";
+					return false;
+				}
+			}
+		} else {
+			for (auto& key : {"x", "y", "width", "height"}) {
+				if (!area.contains(key) || !normalized(area[key])) {
+					LOG(ERROR) << "Roi " << key << " is not exists or not a number in range [0, 1]";
+					return false;
+				}
+			}
+			double right = area["x"].get<double>() + area["width"].get<double>();
+			double bottom = area["y"].get<double>() + area["height"].get<double>();
+			if (right > 1.0 || bottom > 1.0) {
+				LOG(ERROR) << "Roi rectangle exceeds the frame";
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+Slot::Rect Dummy::region(Slot& slot) const {
+	auto it = mRoi.find(slot.streamName());
+	if (it == mRoi.end()) {
+		it = mRoi.find("");
+	}
+	if (it == mRoi.end()) {
+		return Slot::Rect();
+	}
+
+	const AVFrame* source = slot.source();
+	auto& roi = it->second;
+	Slot::Rect rect;
+	rect.x = (int)(roi.mX * source->width);
+	rect.y = (int)(roi.mY * source->height);
+	rect.width = (int)(roi.mWidth * source->width);
+	rect.height = (int)(roi.mHeight * source->height);
+	return rect;
+}
+
+bool Dummy::inside(const Slot& slot, double x, double y) const {
+	auto it = mRoi.find(slot.streamName());
+	if (it == mRoi.end()) {
+		it = mRoi.find("");
+	}
+	if (it == mRoi.end()) {
+		return true;
+	}
+
+	auto& roi = it->second;
+	if (roi.mPolygon.empty()) {
+		return x >= roi.mX && x <= roi.mX + roi.mWidth &&
+		       y >= roi.mY && y <= roi.mY + roi.mHeight;
+	}
+
+	// Ray casting, count polygon edges crossed to the right of the point
+	bool result = false;
+	auto& polygon = roi.mPolygon;
+	for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+		auto& [xi, yi] = polygon[i];
+		auto& [xj, yj] = polygon[j];
+		if ((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi) {
+			result = !result;
+		}
+	}
+	return result;
+}
+
+std::vector<bool> Dummy::detect(std::vector<Slot*>& group) {
+	json streams = json::array();
+	for (auto slot : group) {
+		streams.push_back({{"name", slot->streamName()}, {"timestamp", slot->timestamp()}});
+	}
+	// Every member gets the per frame work, one that reports goes on even if the others stay silent
+	std::vector<bool> result;
+	result.reserve(group.size());
+	for (auto slot : group) {
+		auto& info = slot->info(mType);
+		info["group"] = streams;
+		result.push_back(detect(*slot));
+	}
+	return result;
+}
+
+// Stands in for the work of one pass, a concat group pays it once
+void Dummy::delay() const {
 	if (mDelay > 0) {
-		// info["delayed"] = mDelay;
-		std::this_thread::sleep_for(std::chrono::milliseconds(mDelay));
+		std::this_thread::sleep_for(std::chrono::milliseconds(mDelay.load()));
 	}
+}
+
+bool Dummy::detect([[maybe_unused]]Slot& slot) {
 	if (mDrop) {
 		return false;
 	}
@@ -2,6 +2,9 @@
 
 #include "module.h"
 
+#include <map>
+#include <deque>
+
 #include "queue.h"
 #include "slot.h"
 
@@ -13,8 +16,8 @@ public:
 	Dummy(const json& config,
 	      size_t id,
 	      std::vector<std::vector<Slot>>& slot,
-	      Queue<uint32_t>& queueIn,
-	      std::vector<Queue<uint32_t>>& queueOut,
+	      Queue<Handle>& queueIn,
+	      std::vector<Queue<Handle>>& queueOut,
 	      std::vector<size_t>& queueOutId);
 	Dummy(const Dummy& other) = delete;
 	Dummy(Dummy&& other) noexcept;
@@ -22,19 +25,57 @@ public:
 
 	static bool validate(const json& config);
 
+	// Applies delay and drop to the running module, the rest needs a rebuild
+	void reconfigure(const json& config);
+
 protected:
+	void stop() override;
 	void task() override;
 	virtual bool detect(Slot& slot);
+	// One result per member, each is forwarded on its own
+	virtual std::vector<bool> detect(std::vector<Slot*>& group);
+
+	Slot::Rect region(Slot& slot) const;
+	bool inside(const Slot& slot, double x, double y) const;
 
-	uint64_t mDelay = 0;
-	bool mDrop = false;
+	std::atomic_uint64_t mDelay = 0;
+	std::atomic_bool mDrop = false;
+	size_t mExpired = 0;
+
+	Metrics::Histogram* mProcessTime = nullptr;
+	Metrics::Gauge* mQueueDepth = nullptr;
 
 private:
 	std::vector<std::vector<Slot>>& mSlot;
-	Queue<uint32_t>& mQueueIn;
-	std::vector<Queue<uint32_t>>& mQueueOut;
+	Queue<Handle>& mQueueIn;
+	std::vector<Queue<Handle>>& mQueueOut;
 	std::vector<size_t> mQueueOutId;
 
+	void forward(uint16_t streamId, uint16_t slotId, bool process);
+	void delay() const;
+	void concat(uint16_t streamId, uint16_t slotId);
+
+	// Frames of the concat streams waiting for a group, keyed by stream id
+	bool mConcat = false;
+	int64_t mTolerance = 0;
+	size_t mDepth = 2;
+	std::vector<std::string> mConcatStream;
+	std::map<uint16_t, std::deque<uint16_t>> mPending;
+
+	// Region of interest in coordinates relative to the frame size
+	struct Roi {
+		double mX = 0.0;
+		double mY = 0.0;
+		double mWidth = 1.0;
+		double mHeight = 1.0;
+		std::vector<std::pair<double, double>> mPolygon;
+	};
+
+	// Keyed by stream name, empty name applies to all streams
+	std::map<std::string, Roi> mRoi;
+
+	static bool validateRoi(const json& config);
+
 };
 
 }
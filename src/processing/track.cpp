@@ -0,0 +1,196 @@
+#include "track.h"
+
+#include <algorithm>
+#include <tuple>
+
+#include <glog/logging.h>
+
+namespace Sight::Processing {
+
+Track::Track(const json& config,
+             size_t id,
+             std::vector<std::vector<Slot>>& slot,
+             Queue<Handle>& queueIn,
+             std::vector<Queue<Handle>>& queueOut,
+             std::vector<size_t>& queueOutId) :
+	Dummy(config, id, slot, queueIn, queueOut, queueOutId) {
+	if (config.contains("source")) {
+		mSource = config["source"];
+	}
+	if (config.contains("iou")) {
+		mIou = config["iou"];
+	}
+	if (config.contains("age")) {
+		mAge = config["age"];
+	}
+	if (config.contains("hits")) {
+		mHits = config["hits"];
+	}
+}
+
+Track::Track(Track&& other) noexcept :
+	Dummy(std::move(other)),
+	mSource(std::move(other.mSource)),
+	mIou(std::exchange(other.mIou, 0.0)),
+	mAge(std::exchange(other.mAge, 0)),
+	mHits(std::exchange(other.mHits, 0)),
+	mAlpha(std::exchange(other.mAlpha, 0.0)),
+	mBeta(std::exchange(other.mBeta, 0.0)),
+	mNextId(std::exchange(other.mNextId, 1)),
+	mObject(std::move(other.mObject)) {
+}
+
+Track::~Track() {
+}
+
+bool Track::validate(const json& config) {
+	if (!Dummy::validate(config)) {
+		return false;
+	}
+	if (config.contains("source") && (!config["source"].is_string() || config["source"].empty())) {
+		LOG(ERROR) << "Source is not string or empty";
+		return false;
+	}
+	if (config.contains("iou") &&
+	    (!config["iou"].is_number() || config["iou"] <= 0.0 || config["iou"] > 1.0)) {
+		LOG(ERROR) << "Iou is not a number in range (0, 1]";
+		return false;
+	}
+	if (config.contains("age") && !config["age"].is_number_unsigned()) {
+		LOG(ERROR) << "Age is not unsigned number";
+		return false;
+	}
+	if (config.contains("hits") && (!config["hits"].is_number_unsigned() || config["hits"] == 0)) {
+		LOG(ERROR) << "Hits is not positive number";
+		return false;
+	}
+	return true;
+}
+
+bool Track::detect(Slot& slot) {
+	auto& objects = mObject[slot.streamId()];
+
+	// Predict every track one frame ahead
+	for (auto& object : objects) {
+		object.mBox.mX += object.mVelocity.mX;
+		object.mBox.mY += object.mVelocity.mY;
+		object.mBox.mWidth = std::max(1.0, object.mBox.mWidth + object.mVelocity.mWidth);
+		object.mBox.mHeight = std::max(1.0, object.mBox.mHeight + object.mVelocity.mHeight);
+	}
+
+	// Detector skips frames when running with interval, keep predictions only
+	auto& source = slot.info();
+	bool detected = source.contains(mSource) && source[mSource].contains("objects");
+	if (detected) {
+		auto& detection = source[mSource]["objects"];
+
+		// Greedy matching by descending overlap
+		std::vector<std::tuple<double, size_t, size_t>> pair;
+		for (size_t trackId = 0; trackId < objects.size(); ++trackId) {
+			for (size_t detectionId = 0; detectionId < detection.size(); ++detectionId) {
+				auto& d = detection[detectionId];
+				if (d.value("label", "") != objects[trackId].mLabel) {
+					continue;
+				}
+				Box box = {d["x"], d["y"], d["width"], d["height"]};
+				double iou = overlap(objects[trackId].mBox, box);
+				if (iou >= mIou) {
+					pair.push_back({iou, trackId, detectionId});
+				}
+			}
+		}
+		std::sort(pair.begin(), pair.end(), [](const auto& a, const auto& b) {
+			return std::get<0>(a) > std::get<0>(b);
+		});
+
+		std::vector<bool> trackMatched(objects.size(), false);
+		std::vector<bool> detectionMatched(detection.size(), false);
+		for (auto& [iou, trackId, detectionId] : pair) {
+			if (trackMatched[trackId] || detectionMatched[detectionId]) {
+				continue;
+			}
+			trackMatched[trackId] = true;
+			detectionMatched[detectionId] = true;
+
+			auto& d = detection[detectionId];
+			auto& object = objects[trackId];
+			Box residual = {
+				d["x"].get<double>() - object.mBox.mX,
+				d["y"].get<double>() - object.mBox.mY,
+				d["width"].get<double>() - object.mBox.mWidth,
+				d["height"].get<double>() - object.mBox.mHeight
+			};
+			object.mBox.mX += mAlpha * residual.mX;
+			object.mBox.mY += mAlpha * residual.mY;
+			object.mBox.mWidth += mAlpha * residual.mWidth;
+			object.mBox.mHeight += mAlpha * residual.mHeight;
+			object.mVelocity.mX += mBeta * residual.mX;
+			object.mVelocity.mY += mBeta * residual.mY;
+			object.mVelocity.mWidth += mBeta * residual.mWidth;
+			object.mVelocity.mHeight += mBeta * residual.mHeight;
+			++object.mHits;
+			object.mMisses = 0;
+		}
+
+		for (size_t trackId = 0; trackId < objects.size(); ++trackId) {
+			if (!trackMatched[trackId]) {
+				++objects[trackId].mMisses;
+			}
+		}
+
+		for (size_t detectionId = 0; detectionId < detection.size(); ++detectionId) {
+			if (!detectionMatched[detectionId]) {
+				auto& d = detection[detectionId];
+				Object object;
+				object.mId = mNextId++;
+				object.mLabel = d.value("label", "");
+				object.mBox = {d["x"], d["y"], d["width"], d["height"]};
+				object.mHits = 1;
+				objects.push_back(object);
+			}
+		}
+
+		std::erase_if(objects, [this](const Object& object) {
+			return object.mMisses > mAge;
+		});
+	}
+
+	// Report only tracks that were not reported before
+	bool report = false;
+	auto& info = slot.info(mType);
+	info["objects"] = json::array();
+	for (auto& object : objects) {
+		if (object.mHits < mHits) {
+			continue;
+		}
+		bool fresh = !object.mReported;
+		object.mReported = true;
+		report = report || fresh;
+		info["objects"].push_back({
+			{"id", object.mId},
+			{"label", object.mLabel},
+			{"new", fresh},
+			{"predicted", object.mMisses > 0 || !detected},
+			{"x", object.mBox.mX},
+			{"y", object.mBox.mY},
+			{"width", object.mBox.mWidth},
+			{"height", object.mBox.mHeight}
+		});
+	}
+
+	return report;
+}
+
+double Track::overlap(const Box& a, const Box& b) {
+	double left = std::max(a.mX, b.mX);
+	double top = std::max(a.mY, b.mY);
+	double right = std::min(a.mX + a.mWidth, b.mX + b.mWidth);
+	double bottom = std::min(a.mY + a.mHeight, b.mY + b.mHeight);
+	if (right <= left || bottom <= top) {
+		return 0.0;
+	}
+	double intersection = (right - left) * (bottom - top);
+	return intersection / (a.mWidth * a.mHeight + b.mWidth * b.mHeight - intersection);
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "dummy.h"
+
+#include <map>
+
+namespace Sight::Processing {
+
+class Track
+	: public Dummy {
+public:
+	Track(const json& config,
+	      size_t id,
+	      std::vector<std::vector<Slot>>& slot,
+	      Queue<Handle>& queueIn,
+	      std::vector<Queue<Handle>>& queueOut,
+	      std::vector<size_t>& queueOutId);
+	Track(const Track& other) = delete;
+	Track(Track&& other) noexcept;
+	~Track();
+
+	static bool validate(const json& config);
+
+protected:
+	using Dummy::detect;
+	bool detect(Slot& slot) override;
+
+private:
+	struct Box {
+		double mX = 0.0;
+		double mY = 0.0;
+		double mWidth = 0.0;
+		double mHeight = 0.0;
+	};
+
+	// Constant velocity track smoothed with an alpha-beta filter
+	struct Object {
+		uint64_t mId = 0;
+		std::string mLabel;
+		Box mBox;
+		Box mVelocity;
+		size_t mHits = 0;
+		size_t mMisses = 0;
+		bool mReported = false;
+	};
+
+	static double overlap(const Box& a, const Box& b);
+
+	std::string mSource = "detect";
+	double mIou = 0.3;
+	size_t mAge = 30;
+	size_t mHits = 3;
+	double mAlpha = 0.5;
+	double mBeta = 0.1;
+
+	uint64_t mNextId = 1;
+	std::map<size_t, std::vector<Object>> mObject;
+
+};
+
+}
@@ -83,7 +83,11 @@ void Queue<T>::remove() {
 template <typename T>
 bool Queue<T>::ready(int64_t msec) const {
 	std::unique_lock<std::mutex> lg(mReadyLock);
-	if (mReady.wait_for(lg, std::chrono::milliseconds(msec), [this]{return !mQueue.empty();})) {
+	auto filled = [this] {
+		std::lock_guard<std::mutex> lg(mLock);
+		return !mQueue.empty();
+	};
+	if (mReady.wait_for(lg, std::chrono::milliseconds(msec), filled)) {
 		return true;
 	}
 	return false;
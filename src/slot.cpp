@@ -1,13 +1,19 @@
 #include "slot.h"
 
+#include <algorithm>
+
 #include <glog/logging.h>
 
+#include "arena.h"
+
 namespace Sight {
 
-Slot::Slot(size_t streamId, const std::string& streamName, size_t stageCount) :
+Slot::Slot(size_t streamId, const std::string& streamName, size_t stageCount,
+           std::chrono::milliseconds latency) :
 	mStreamId(streamId),
 	mStreamName(streamName),
-	mStageCount(stageCount) {
+	mStageCount(stageCount),
+	mLatency(latency) {
 	mSource = av_frame_alloc();
 	if (!mSource) {
 		LOG(ERROR) << "Failed to allocate memory for AVFrame";
@@ -18,6 +24,10 @@ Slot::Slot(const Slot& other) :
 	mStreamId(other.mStreamId),
 	mStreamName(other.mStreamName),
 	mStageCount(other.mStageCount),
+	mLatency(other.mLatency),
+	mNode(other.mNode),
+	mTimestamp(other.mTimestamp),
+	mCaptured(other.mCaptured),
 	mInfo(other.mInfo),
 	mFresh(other.mFresh) {
 	mSource = av_frame_alloc();
@@ -30,7 +40,7 @@ Slot::Slot(const Slot& other) :
 	mSource->width = other.mSource->width;
 	mSource->height = other.mSource->height;
 
-	if (av_frame_get_buffer(mSource, 0) < 0) {
+	if (!Arena::allocate(mSource)) {
 		LOG(ERROR) << "Failed to allocate buffer";
 		return;
 	}
@@ -50,8 +60,13 @@ Slot::Slot(Slot&& other) noexcept :
 	mStreamId(std::exchange(other.mStreamId, 0)),
 	mStreamName(std::move(other.mStreamName)),
 	mStageCount(std::exchange(other.mStageCount, 0)),
+	mLatency(other.mLatency),
+	mNode(other.mNode),
+	mTimestamp(std::exchange(other.mTimestamp, 0)),
+	mCaptured(other.mCaptured),
 	mInfo(std::move(other.mInfo)),
 	mFresh(std::exchange(other.mFresh, false)),
+	mGeneration(other.mGeneration.load()),
 	mSource(std::exchange(other.mSource, NULL)),
 	mFrame(std::move(other.mFrame)) {
 }
@@ -64,7 +79,6 @@ Slot::~Slot() {
 void Slot::clear() {
 	std::lock_guard<std::mutex> lg(mLockFrame);
 	for (auto& f : mFrame) {
-		av_freep(&f.mFrame->data[0]);
 		av_frame_free(&f.mFrame);
 		sws_freeContext(f.mSwsContext);
 	}
@@ -83,7 +97,7 @@ void Slot::wait() const {
 	mReady.wait(true);
 }
 
-void Slot::reset() {
+void Slot::reset(AVRational timeBase) {
 	if (mSource->width != mWidth || mSource->height != mHeight ||
 	    mSource->pts <= mPts || mSource->pkt_dts <= mDts) {
 		mWidth = mSource->width;
@@ -93,7 +107,10 @@ void Slot::reset() {
 	}
 	mPts = mSource->pts;
 	mDts = mSource->pkt_dts;
+	mTimestamp = av_rescale_q(mPts, timeBase, AV_TIME_BASE_Q);
+	mCaptured = std::chrono::steady_clock::now();
 	mReference = mStageCount;
+	mGeneration.store((mGeneration.load(std::memory_order_relaxed) + 1) & kGenerationMask, std::memory_order_relaxed);
 	mReady.test_and_set();
 }
 
@@ -106,6 +123,51 @@ void Slot::unref() {
 	}
 }
 
+int64_t Slot::timestamp() const {
+	return mTimestamp;
+}
+
+std::chrono::steady_clock::time_point Slot::captured() const {
+	return mCaptured;
+}
+
+void Slot::release() {
+	// Slot is not in flight, drop the buffers until it is used again
+	av_frame_unref(mSource);
+	clear();
+	mWidth = 0;
+	mHeight = 0;
+}
+
+void Slot::place(int node) {
+	mNode = node;
+}
+
+size_t Slot::memory() const {
+	size_t bytes = 0;
+	if (mSource->buf[0]) {
+		int size = av_image_get_buffer_size((AVPixelFormat)mSource->format, mSource->width, mSource->height, 1);
+		bytes += size > 0 ? size : 0;
+	}
+	std::lock_guard<std::mutex> lg(mLockFrame);
+	for (auto& f : mFrame) {
+		int size = av_image_get_buffer_size((AVPixelFormat)f.mFrame->format, f.mFrame->width, f.mFrame->height, 1);
+		bytes += size > 0 ? size : 0;
+	}
+	return bytes;
+}
+
+uint32_t Slot::generation() const {
+	return mGeneration.load(std::memory_order_relaxed);
+}
+
+bool Slot::expired() const {
+	if (mLatency.count() == 0) {
+		return false;
+	}
+	return std::chrono::steady_clock::now() - mCaptured > mLatency;
+}
+
 size_t Slot::streamId() const {
 	return mStreamId;
 }
@@ -119,33 +181,56 @@ AVFrame* Slot::source() {
 }
 
 const AVFrame* Slot::frame(AVPixelFormat format, int width, int height, int scale) {
+	return frame(Rect(), format, width, height, scale);
+}
+
+const AVFrame* Slot::frame(const Rect& crop, AVPixelFormat format, int width, int height, int scale) {
 	std::lock_guard<std::mutex> lg(mLockFrame);
 
+	// Crop outside of the source or covering it falls back to the whole frame
+	Rect rect = align(crop);
+	int sourceWidth = rect.empty() ? mSource->width : rect.width;
+	int sourceHeight = rect.empty() ? mSource->height : rect.height;
+
 	// Default to original frame
-	if ((format == AV_PIX_FMT_NONE) ||
-	    (format == mSource->format  && ((width == 0 && height == 0) ||
-	     (width == mSource->width && height == mSource->height)))) {
+	if (rect.empty() &&
+	    ((format == AV_PIX_FMT_NONE) ||
+	     (format == mSource->format  && ((width == 0 && height == 0) ||
+	      (width == mSource->width && height == mSource->height))))) {
 		return mSource;
 	}
 
+	// Crop in the original format
+	if (format == AV_PIX_FMT_NONE) {
+		format = (AVPixelFormat)mSource->format;
+	}
+
 	// Tune dimensions to preserve aspect ratio
 	if (width == 0 && height != 0) {
-		double factor = (double)mSource->width / (double)mSource->height;
+		double factor = (double)sourceWidth / (double)sourceHeight;
 		width = (int)((double)height * factor);
 	} else if (height == 0 && width != 0) {
-		double factor = (double)mSource->height / (double)mSource->width;
+		double factor = (double)sourceHeight / (double)sourceWidth;
 		height = (int)((double)width * factor);
 	} else if (width == 0 && height == 0) {
-		width = mSource->width;
-		height = mSource->height;
+		width = sourceWidth;
+		height = sourceHeight;
+	}
+
+	uint8_t* data[4];
+	int linesize[4];
+	if (!planes(rect, data, linesize)) {
+		LOG(ERROR) << "Failed to crop frame, pixel format = " << mSource->format;
+		return nullptr;
 	}
 
 	// Frame with the same format already exists
 	for (auto& f : mFrame) {
-		if (f.mFrame->format == format && f.mFrame->width == width && f.mFrame->height == height) {
+		if (f.mFrame->format == format && f.mFrame->width == width && f.mFrame->height == height &&
+		    f.mCrop == rect) {
 			if (f.mFrame->coded_picture_number != mSource->coded_picture_number) {
-				sws_scale(f.mSwsContext, (const uint8_t* const*)mSource->data, mSource->linesize, 0,
-				          f.mFrame->height, f.mFrame->data, f.mFrame->linesize);
+				sws_scale(f.mSwsContext, (const uint8_t* const*)data, linesize, 0,
+				          sourceHeight, f.mFrame->data, f.mFrame->linesize);
 				f.mFrame->coded_picture_number = mSource->coded_picture_number;
 			}
 			return f.mFrame;
@@ -175,7 +260,8 @@ const AVFrame* Slot::frame(AVPixelFormat format, int width, int height, int scal
 			break;
 	}
 
-	frame.mSwsContext = sws_getContext(mSource->width, mSource->height, pixFormat,
+	frame.mCrop = rect;
+	frame.mSwsContext = sws_getContext(sourceWidth, sourceHeight, pixFormat,
 	                       width, height, format,
 	                       scale, NULL, NULL, NULL);
 	if (!frame.mSwsContext) {
@@ -200,17 +286,15 @@ const AVFrame* Slot::frame(AVPixelFormat format, int width, int height, int scal
 	frame.mFrame->width = width;
 	frame.mFrame->height = height;
 
-	int ret = av_image_alloc(frame.mFrame->data, frame.mFrame->linesize,
-	                         frame.mFrame->width, frame.mFrame->height,
-	                         format, 32);
-	if (ret < 0) {
+	// Processing threads may run on another node than the stream, the buffer stays with the stream
+	if (!Arena::allocate(frame.mFrame, Arena::kAlign, mNode)) {
 		av_frame_free(&frame.mFrame);
 		LOG(ERROR) << "Failed to allocate memory for AVFrame buffer";
 		return nullptr;
 	}
 
-	sws_scale(frame.mSwsContext, (const uint8_t* const*)mSource->data, mSource->linesize, 0,
-	          frame.mFrame->height, frame.mFrame->data, frame.mFrame->linesize);
+	sws_scale(frame.mSwsContext, (const uint8_t* const*)data, linesize, 0,
+	          sourceHeight, frame.mFrame->data, frame.mFrame->linesize);
 	frame.mFrame->coded_picture_number = mSource->coded_picture_number;
 
 	mFrame.push_back(frame);
@@ -218,6 +302,71 @@ const AVFrame* Slot::frame(AVPixelFormat format, int width, int height, int scal
 	return mFrame.back().mFrame;
 }
 
+bool Slot::Rect::empty() const {
+	return width <= 0 || height <= 0;
+}
+
+Slot::Rect Slot::align(const Rect& rect) const {
+	if (rect.empty()) {
+		return Rect();
+	}
+
+	// Clamp to the source frame
+	Rect result;
+	result.x = std::clamp(rect.x, 0, mSource->width);
+	result.y = std::clamp(rect.y, 0, mSource->height);
+	result.width = std::min(rect.x + rect.width, mSource->width) - result.x;
+	result.height = std::min(rect.y + rect.height, mSource->height) - result.y;
+
+	// Chroma planes can only be offset by whole samples
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)mSource->format);
+	if (desc) {
+		int alignX = (1 << desc->log2_chroma_w) - 1;
+		int alignY = (1 << desc->log2_chroma_h) - 1;
+		result.width += result.x & alignX;
+		result.height += result.y & alignY;
+		result.x &= ~alignX;
+		result.y &= ~alignY;
+	}
+
+	if (result.empty() || (result.x == 0 && result.y == 0 &&
+	    result.width == mSource->width && result.height == mSource->height)) {
+		return Rect();
+	}
+	return result;
+}
+
+bool Slot::planes(const Rect& rect, uint8_t* data[4], int linesize[4]) const {
+	for (size_t plane = 0; plane < 4; ++plane) {
+		data[plane] = mSource->data[plane];
+		linesize[plane] = mSource->linesize[plane];
+	}
+	if (rect.empty()) {
+		return true;
+	}
+
+	const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)mSource->format);
+	if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL))) {
+		return false;
+	}
+
+	// Offset every plane to the top left corner of the crop
+	for (int plane = 0; plane < 4 && data[plane]; ++plane) {
+		int step = 0;
+		for (int comp = 0; comp < desc->nb_components; ++comp) {
+			if (desc->comp[comp].plane == plane) {
+				step = desc->comp[comp].step;
+				break;
+			}
+		}
+		bool chroma = plane == 1 || plane == 2;
+		int shiftX = chroma ? desc->log2_chroma_w : 0;
+		int shiftY = chroma ? desc->log2_chroma_h : 0;
+		data[plane] += (rect.y >> shiftY) * linesize[plane] + (rect.x >> shiftX) * step;
+	}
+	return true;
+}
+
 const json& Slot::info() const {
 	return mInfo;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <map>
 #include <string>
 #include <vector>
@@ -10,6 +11,7 @@ extern "C" {
 #	include <libavcodec/avcodec.h>
 #	include <libavformat/avformat.h>
 #	include <libavutil/imgutils.h>
+#	include <libavutil/pixdesc.h>
 #	include <libswscale/swscale.h>
 }
 
@@ -21,49 +23,83 @@ using json = nlohmann::json;
 
 class Slot {
 public:
+	// Region of the source frame in pixels, empty means whole frame
+	struct Rect {
+		int x = 0;
+		int y = 0;
+		int width = 0;
+		int height = 0;
+
+		bool empty() const;
+		bool operator==(const Rect& other) const = default;
+	};
+
+	// Generations wrap at 24 bits, the width they have in a handle
+	static constexpr uint32_t kGenerationMask = 0xffffff;
+
 	Slot(size_t streamId,
 	     const std::string& streamName,
-	     size_t stageCount);
+	     size_t stageCount,
+	     std::chrono::milliseconds latency = std::chrono::milliseconds(0));
 	Slot(const Slot& slot);
 	Slot(Slot&& slot) noexcept;
 	~Slot();
 
 	bool ready() const;
 	void wait() const;
-	void reset();
+	void reset(AVRational timeBase = AV_TIME_BASE_Q);
 	void unref();
+	void release();
+	size_t memory() const;
 	size_t streamId() const;
 	const std::string& streamName() const;
 	bool fresh() const;
+	int64_t timestamp() const;
+	std::chrono::steady_clock::time_point captured() const;
+	bool expired() const;
+	uint32_t generation() const;
+	// Conversion buffers are bound to the NUMA node, -1 leaves them where they are first touched
+	void place(int node);
 
 	AVFrame* source();
 	const AVFrame* frame(AVPixelFormat format = AV_PIX_FMT_NONE, int width = 0, int height = 0, int scale = SWS_BICUBIC);
+	const AVFrame* frame(const Rect& crop, AVPixelFormat format = AV_PIX_FMT_NONE, int width = 0, int height = 0, int scale = SWS_BICUBIC);
 
 	const json& info() const;
 	json& info(const std::string& type);
 
+	// Crop frame(crop) converts, clamped and moved to chroma sample bounds, empty when it covers the frame
+	Rect align(const Rect& rect) const;
+
 private:
 	size_t mStreamId = 0;
 	std::string mStreamName;
 	size_t mStageCount = 0;
+	std::chrono::milliseconds mLatency = std::chrono::milliseconds(0);
+	int mNode = -1;
 
 	void clear();
+	bool planes(const Rect& rect, uint8_t* data[4], int linesize[4]) const;
 
 	struct Frame {
 		AVFrame* mFrame = NULL;
 		SwsContext* mSwsContext = NULL;
+		Rect mCrop;
 	};
 
 	int mWidth = 0;
 	int mHeight = 0;
 	int64_t mDts = 0;
 	int64_t mPts = 0;
+	int64_t mTimestamp = 0;
+	std::chrono::steady_clock::time_point mCaptured;
 
 	json mInfo;
 	mutable std::mutex mLockInfo;
 
 	bool mFresh = true;
 	std::atomic_ushort mReference = 0;
+	std::atomic_uint32_t mGeneration = 0;
 	mutable std::atomic_flag mReady = ATOMIC_FLAG_INIT;
 
 	AVFrame* mSource = NULL;
@@ -0,0 +1,211 @@
+#include "thread.h"
+
+#include <fstream>
+#include <map>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef __FreeBSD__
+#	include <pthread_np.h>
+#	include <sys/cpuset.h>
+#	include <sys/sysctl.h>
+#endif
+
+#include <glog/logging.h>
+
+#include "numa.h"
+
+namespace Sight {
+
+namespace {
+
+// Batch and idle are Linux only
+const std::map<std::string, int> kPolicy = {
+	{"other", SCHED_OTHER},
+#ifdef __linux__
+	{"batch", SCHED_BATCH},
+	{"idle", SCHED_IDLE},
+#endif
+	{"fifo", SCHED_FIFO},
+	{"rr", SCHED_RR}
+};
+
+#ifdef __FreeBSD__
+using cpu_set_t = cpuset_t;
+#endif
+
+}
+
+Thread::Thread(const json& config) {
+	if (config.contains("cpus")) {
+		parse(config["cpus"], mCpus);
+	}
+	if (config.contains("node")) {
+		mNode = config["node"];
+	}
+	if (config.contains("policy")) {
+		mPolicy = kPolicy.at(config["policy"]);
+	}
+	if (config.contains("priority")) {
+		mPriority = config["priority"];
+	}
+	if (config.contains("nice")) {
+		mNiceSet = true;
+		mNice = config["nice"];
+	}
+
+	// Node alone means any core of that node
+	if (mCpus.empty() && mNode >= 0) {
+		mCpus = cpus(mNode);
+	}
+}
+
+bool Thread::validate(const json& config, bool partial) {
+	if (!config.is_object()) {
+		LOG(ERROR) << "Thread is not an object";
+		return false;
+	}
+	std::vector<int> list;
+	if (config.contains("cpus") && (!config["cpus"].is_string() || !parse(config["cpus"], list))) {
+		LOG(ERROR) << "Thread cpus is not a cpu list like 0-3,8";
+		return false;
+	}
+	if (config.contains("node") && (!config["node"].is_number_unsigned() || config["node"] >= nodes())) {
+		LOG(ERROR) << "Thread node is not a NUMA node of this machine";
+		return false;
+	}
+	if (config.contains("policy") && (!config["policy"].is_string() || !kPolicy.contains(config["policy"]))) {
+		LOG(ERROR) << "Thread policy is not one of other, fifo, rr or, on Linux, batch or idle";
+		return false;
+	}
+	if (config.contains("priority") &&
+	    (!config["priority"].is_number_unsigned() || config["priority"] < 1 || config["priority"] > 99)) {
+		LOG(ERROR) << "Thread priority is not a number from 1 to 99";
+		return false;
+	}
+	if (!partial && config.contains("priority") && config.value("policy", "") != "fifo" && config.value("policy", "") != "rr") {
+		LOG(ERROR) << "Thread priority needs fifo or rr policy";
+		return false;
+	}
+	if (config.contains("nice") &&
+	    (!config["nice"].is_number_integer() || config["nice"] < -20 || config["nice"] > 19)) {
+		LOG(ERROR) << "Thread nice is not a number from -20 to 19";
+		return false;
+	}
+	if (config.contains("placement") &&
+	    (!config["placement"].is_string() || (config["placement"] != "none" && config["placement"] != "node"))) {
+		LOG(ERROR) << "Thread placement is not one of none or node";
+		return false;
+	}
+	return true;
+}
+
+void Thread::apply(const std::string& name) const {
+	if (!mCpus.empty()) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : mCpus) {
+			CPU_SET(cpu, &set);
+		}
+		int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if (error != 0) {
+			LOG(WARNING) << name << ": Could not set cpu affinity, error = " << error;
+		}
+	}
+	if (mPolicy >= 0) {
+		sched_param param = {};
+		param.sched_priority = mPriority;
+		int error = pthread_setschedparam(pthread_self(), mPolicy, &param);
+		if (error != 0) {
+			LOG(WARNING) << name << ": Could not set scheduling policy, error = " << error;
+		}
+	}
+	if (mNiceSet) {
+#ifdef __linux__
+		// Nice is per thread on Linux when given the thread id
+		if (setpriority(PRIO_PROCESS, gettid(), mNice) != 0) {
+			LOG(WARNING) << name << ": Could not set nice level " << mNice;
+		}
+#else
+		LOG(WARNING) << name << ": Nice level per thread is not supported on this system";
+#endif
+	}
+	if (mNode >= 0) {
+		Numa::prefer(mNode);
+	}
+}
+
+int Thread::node() const {
+	return mNode;
+}
+
+size_t Thread::nodes() {
+	size_t count = 0;
+#if defined(__linux__)
+	while (access(("/sys/devices/system/node/node" + std::to_string(count)).c_str(), F_OK) == 0) {
+		++count;
+	}
+#elif defined(__FreeBSD__)
+	int domains = 0;
+	size_t length = sizeof(domains);
+	if (sysctlbyname("vm.ndomains", &domains, &length, NULL, 0) == 0 && domains > 0) {
+		count = domains;
+	}
+#endif
+	return std::max<size_t>(count, 1);
+}
+
+std::vector<int> Thread::cpus(int node) {
+	std::vector<int> result;
+#if defined(__linux__)
+	std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+	std::string list;
+	if (std::getline(file, list)) {
+		parse(list, result);
+	}
+#elif defined(__FreeBSD__)
+	cpuset_t set;
+	CPU_ZERO(&set);
+	if (cpuset_getaffinity(CPU_LEVEL_WHICH, CPU_WHICH_DOMAIN, node, sizeof(set), &set) == 0) {
+		for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+			if (CPU_ISSET(cpu, &set)) {
+				result.push_back(cpu);
+			}
+		}
+	}
+#endif
+	return result;
+}
+
+bool Thread::parse(const std::string& list, std::vector<int>& cpus) {
+	cpus.clear();
+	size_t begin = 0;
+	while (begin < list.size()) {
+		size_t end = list.find(',', begin);
+		std::string range = list.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+		begin = end == std::string::npos ? list.size() : end + 1;
+
+		// The whole range has to be read, "5x" is not cpu 5
+		int first = 0;
+		int last = 0;
+		int used = 0;
+		if (std::sscanf(range.c_str(), "%d-%d%n", &first, &last, &used) == 2 && used == (int)range.size()) {
+		} else if (std::sscanf(range.c_str(), "%d%n", &first, &used) == 1 && used == (int)range.size()) {
+			last = first;
+		} else {
+			return false;
+		}
+		if (first < 0 || last < first || last >= CPU_SETSIZE) {
+			return false;
+		}
+		for (int cpu = first; cpu <= last; ++cpu) {
+			cpus.push_back(cpu);
+		}
+	}
+	return !cpus.empty();
+}
+
+}
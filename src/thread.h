@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace Sight {
+
+using json = nlohmann::json;
+
+// Placement and scheduling of a module thread, from the "thread" config object
+class Thread {
+public:
+	Thread() = default;
+	Thread(const json& config);
+
+	// Partial settings are defaults for others and are checked field by field, the merged result fully
+	static bool validate(const json& config, bool partial = false);
+
+	// Applies to the calling thread, failures are logged and the thread runs unpinned
+	void apply(const std::string& name) const;
+	int node() const;
+
+	static size_t nodes();
+	static std::vector<int> cpus(int node);
+	static bool parse(const std::string& list, std::vector<int>& cpus);
+
+private:
+	std::vector<int> mCpus;
+	int mNode = -1;
+	int mPolicy = -1;
+	int mPriority = 0;
+	bool mNiceSet = false;
+	int mNice = 0;
+
+};
+
+}
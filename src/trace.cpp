@@ -0,0 +1,178 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#include <glog/logging.h>
+#include <nlohmann/json.hpp>
+
+namespace Sight {
+
+std::atomic_bool Trace::mEnabled = false;
+std::mutex Trace::mLock;
+std::list<std::unique_ptr<Trace::Buffer>> Trace::mBuffer;
+
+thread_local std::string Trace::tThread;
+thread_local Trace::Owner Trace::tOwner;
+
+Trace::Owner::~Owner() {
+	if (mBuffer) {
+		std::lock_guard<std::mutex> lg(mLock);
+		mBuffer->mFree = true;
+	}
+}
+
+void Trace::enable(bool enabled) {
+	mEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Trace::enabled() {
+	return mEnabled.load(std::memory_order_relaxed);
+}
+
+void Trace::thread(const std::string& name) {
+	tThread = name;
+}
+
+int64_t Trace::now() {
+	auto tp = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count();
+}
+
+void Trace::instant(const char* name, size_t stream, size_t slot, int64_t frame) {
+	if (!enabled()) {
+		return;
+	}
+	record({
+		.mName = name,
+		.mPhase = 'i',
+		.mBegin = now(),
+		.mStream = (uint32_t)stream,
+		.mSlot = (uint32_t)slot,
+		.mFrame = frame
+	});
+}
+
+void Trace::complete(const char* name, int64_t begin, size_t stream, size_t slot, int64_t frame) {
+	if (!enabled()) {
+		return;
+	}
+	record({
+		.mName = name,
+		.mPhase = 'X',
+		.mBegin = begin,
+		.mDuration = now() - begin,
+		.mStream = (uint32_t)stream,
+		.mSlot = (uint32_t)slot,
+		.mFrame = frame
+	});
+}
+
+void Trace::record(const Event& event) {
+	Buffer* buffer = tOwner.mBuffer;
+	if (buffer == nullptr) {
+		// Threads come and go with reloads and reconnects, reuse the ring of one that exited
+		std::lock_guard<std::mutex> lg(mLock);
+		for (auto& free : mBuffer) {
+			if (free->mFree) {
+				buffer = free.get();
+				break;
+			}
+		}
+		if (buffer == nullptr) {
+			mBuffer.push_back(std::make_unique<Buffer>());
+			buffer = mBuffer.back().get();
+		}
+		buffer->mThread = tThread;
+		buffer->mFree = false;
+		buffer->mStart = buffer->mHead.load(std::memory_order_relaxed);
+		tOwner.mBuffer = buffer;
+	}
+
+	// Odd sequence while the entry is written, even with its event id once done
+	uint64_t head = buffer->mHead.load(std::memory_order_relaxed);
+	auto& entry = buffer->mEntry[head % Buffer::kCapacity];
+	entry.mSequence.store(head * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	entry.mName.store(event.mName, std::memory_order_relaxed);
+	entry.mPhase.store(event.mPhase, std::memory_order_relaxed);
+	entry.mBegin.store(event.mBegin, std::memory_order_relaxed);
+	entry.mDuration.store(event.mDuration, std::memory_order_relaxed);
+	entry.mStream.store(event.mStream, std::memory_order_relaxed);
+	entry.mSlot.store(event.mSlot, std::memory_order_relaxed);
+	entry.mFrame.store(event.mFrame, std::memory_order_relaxed);
+	entry.mSequence.store(head * 2 + 2, std::memory_order_release);
+	buffer->mHead.store(head + 1, std::memory_order_release);
+}
+
+bool Trace::dump(const std::string& path) {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		LOG(ERROR) << "Can't open trace file = " << path;
+		return false;
+	}
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	std::lock_guard<std::mutex> lg(mLock);
+	size_t tid = 0;
+	for (auto& buffer : mBuffer) {
+		++tid;
+
+		// Copy a snapshot, entries the writer is rewriting or has moved past are left out
+		uint64_t head = buffer->mHead.load(std::memory_order_acquire);
+		uint64_t tail = head > Buffer::kCapacity ? head - Buffer::kCapacity : 0;
+		tail = std::max(tail, buffer->mStart);
+		std::vector<Event> event;
+		event.reserve(head - tail);
+		for (uint64_t id = tail; id < head; ++id) {
+			auto& entry = buffer->mEntry[id % Buffer::kCapacity];
+			uint64_t sequence = entry.mSequence.load(std::memory_order_acquire);
+			if (sequence != id * 2 + 2) {
+				continue;
+			}
+			Event e;
+			e.mName = entry.mName.load(std::memory_order_relaxed);
+			e.mPhase = entry.mPhase.load(std::memory_order_relaxed);
+			e.mBegin = entry.mBegin.load(std::memory_order_relaxed);
+			e.mDuration = entry.mDuration.load(std::memory_order_relaxed);
+			e.mStream = entry.mStream.load(std::memory_order_relaxed);
+			e.mSlot = entry.mSlot.load(std::memory_order_relaxed);
+			e.mFrame = entry.mFrame.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (entry.mSequence.load(std::memory_order_relaxed) != sequence) {
+				continue;
+			}
+			event.push_back(e);
+		}
+
+		file << (first ? "" : ",")
+		     << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+		     << ",\"args\":{\"name\":" << nlohmann::json(buffer->mThread).dump() << "}}";
+		first = false;
+		for (auto& e : event) {
+			file << ",{\"name\":\"" << e.mName << "\",\"ph\":\"" << e.mPhase
+			     << "\",\"ts\":" << e.mBegin;
+			if (e.mPhase == 'X') {
+				file << ",\"dur\":" << e.mDuration;
+			} else {
+				file << ",\"s\":\"t\"";
+			}
+			file << ",\"pid\":1,\"tid\":" << tid
+			     << ",\"args\":{\"stream\":" << e.mStream
+			     << ",\"slot\":" << e.mSlot
+			     << ",\"frame\":" << e.mFrame << "}}";
+		}
+	}
+	file << "]}";
+
+	if (file.fail()) {
+		LOG(ERROR) << "Can't write trace file = " << path;
+		return false;
+	}
+	LOG(INFO) << "Trace written to " << path;
+	return true;
+}
+
+}
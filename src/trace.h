@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Sight {
+
+// Per frame trace stamps, exported in Chrome trace event format
+class Trace {
+public:
+	static void enable(bool enabled);
+	static bool enabled();
+
+	static void thread(const std::string& name);
+	static int64_t now();
+
+	static void instant(const char* name, size_t stream, size_t slot, int64_t frame);
+	static void complete(const char* name, int64_t begin, size_t stream, size_t slot, int64_t frame);
+
+	static bool dump(const std::string& path);
+
+private:
+	struct Event {
+		const char* mName = nullptr;
+		char mPhase = 'i';
+		int64_t mBegin = 0;
+		int64_t mDuration = 0;
+		uint32_t mStream = 0;
+		uint32_t mSlot = 0;
+		int64_t mFrame = 0;
+	};
+
+	// Event stored field by field, the sequence tells a reader whether it saw a whole event
+	struct Entry {
+		std::atomic_uint64_t mSequence = 0;
+		std::atomic<const char*> mName = nullptr;
+		std::atomic_char mPhase = 'i';
+		std::atomic_int64_t mBegin = 0;
+		std::atomic_int64_t mDuration = 0;
+		std::atomic_uint32_t mStream = 0;
+		std::atomic_uint32_t mSlot = 0;
+		std::atomic_int64_t mFrame = 0;
+	};
+
+	// Ring of events written by a single thread, kept after the thread exits and reused by the next one
+	struct Buffer {
+		static constexpr size_t kCapacity = 16384;
+
+		std::string mThread;
+		bool mFree = false;
+		uint64_t mStart = 0;
+		std::array<Entry, kCapacity> mEntry;
+		std::atomic_uint64_t mHead = 0;
+	};
+
+	// Hands the buffer back when its thread exits
+	struct Owner {
+		Buffer* mBuffer = nullptr;
+		~Owner();
+	};
+
+	static void record(const Event& event);
+
+	static std::atomic_bool mEnabled;
+	static std::mutex mLock;
+	static std::list<std::unique_ptr<Buffer>> mBuffer;
+
+	static thread_local std::string tThread;
+	static thread_local Owner tOwner;
+
+};
+
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include "arena.h"
+
+using namespace Sight;
+
+TEST(Arena, ReusesFreedBlocks) {
+	// Reserve fails when another test already did, the arena is process wide
+	Arena::reserve(8 * 1024 * 1024);
+
+	AVFrame* frame = av_frame_alloc();
+	frame->format = AV_PIX_FMT_YUV420P;
+	frame->width = 1920;
+	frame->height = 1080;
+	ASSERT_TRUE(Arena::allocate(frame));
+	EXPECT_TRUE(Arena::contains(frame->data[0]));
+	EXPECT_EQ((uintptr_t)frame->data[0] % Arena::kAlign, 0u);
+	EXPECT_EQ(frame->linesize[0] % Arena::kAlign, 0);
+	uint8_t* data = frame->data[0];
+	av_frame_unref(frame);
+
+	frame->format = AV_PIX_FMT_YUV420P;
+	frame->width = 1920;
+	frame->height = 1080;
+	ASSERT_TRUE(Arena::allocate(frame));
+	EXPECT_EQ(frame->data[0], data);
+	av_frame_free(&frame);
+}
+
+TEST(Arena, FallsBackToHeap) {
+	Arena::reserve(8 * 1024 * 1024);
+	AVBufferRef* large = Arena::buffer(64 * 1024 * 1024);
+	ASSERT_NE(large, nullptr);
+	EXPECT_FALSE(Arena::contains(large->data));
+	av_buffer_unref(&large);
+}
+
+TEST(Arena, MergesFreedBlocks) {
+	Arena::reserve(8 * 1024 * 1024);
+	AVBufferRef* first = Arena::buffer(1024 * 1024);
+	AVBufferRef* second = Arena::buffer(1024 * 1024);
+	AVBufferRef* last = Arena::buffer(4096);
+	ASSERT_TRUE(first && second && last);
+	ASSERT_TRUE(Arena::contains(first->data) && Arena::contains(last->data));
+	uint8_t* data = first->data;
+	av_buffer_unref(&first);
+	av_buffer_unref(&second);
+
+	// Both freed blocks serve one buffer of their joint size, then a smaller one from what is left
+	AVBufferRef* joint = Arena::buffer(2 * 1024 * 1024);
+	ASSERT_NE(joint, nullptr);
+	EXPECT_EQ(joint->data, data);
+	av_buffer_unref(&joint);
+	AVBufferRef* small = Arena::buffer(512 * 1024);
+	ASSERT_NE(small, nullptr);
+	EXPECT_EQ(small->data, data);
+	av_buffer_unref(&small);
+	av_buffer_unref(&last);
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include "graph.h"
+
+using namespace Sight;
+
+namespace {
+
+json node(const std::string& name, const json& out = json()) {
+	json n = {{"name", name}, {"type", "dummy"}};
+	if (!out.is_null()) {
+		n["out"] = out;
+	}
+	return n;
+}
+
+// input -> a -> b -> c -> output, a also feeds the output directly
+json diamond() {
+	return {
+		{"input", {node("in", {"a"})}},
+		{"processing", {node("a", {"b", "out"}), node("b", {"c"}), node("c", {"out"})}},
+		{"output", {node("out")}}
+	};
+}
+
+// A chain of diamonds, the path count doubles with every link
+json chain(size_t links) {
+	json config = {{"input", {node("in", {"p0"})}}, {"processing", json::array()}, {"output", {node("out")}}};
+	for (size_t link = 0; link < links; ++link) {
+		std::string next = "p" + std::to_string(link + 1);
+		std::string left = "l" + std::to_string(link);
+		std::string right = "r" + std::to_string(link);
+		config["processing"].push_back(node("p" + std::to_string(link), {left, right}));
+		config["processing"].push_back(node(left, {next}));
+		config["processing"].push_back(node(right, {next}));
+	}
+	config["processing"].push_back(node("p" + std::to_string(links), {"out"}));
+	return config;
+}
+
+}
+
+TEST(Graph, Nodes) {
+	Graph graph(diamond());
+	ASSERT_EQ(graph.size(), 5u);
+	EXPECT_EQ(graph.node(Graph::Kind::input, 0), 0u);
+	EXPECT_EQ(graph.node(Graph::Kind::processing, 1), 2u);
+	EXPECT_EQ(graph.node(Graph::Kind::output, 0), 4u);
+	EXPECT_EQ(graph[2].mName, "b");
+	EXPECT_EQ(graph[2].mKind, Graph::Kind::processing);
+	EXPECT_EQ(graph[2].mIndex, 1u);
+	EXPECT_EQ(graph[1].mOut, std::vector<size_t>({2, 4}));
+}
+
+TEST(Graph, Order) {
+	Graph graph(diamond());
+	ASSERT_TRUE(graph.acyclic());
+	EXPECT_TRUE(graph.cycle().empty());
+
+	std::vector<size_t> position(graph.size());
+	for (size_t i = 0; i < graph.order().size(); ++i) {
+		position[graph.order()[i]] = i;
+	}
+	for (size_t id = 0; id < graph.size(); ++id) {
+		for (auto& to : graph[id].mOut) {
+			EXPECT_LT(position[id], position[to]);
+		}
+	}
+}
+
+TEST(Graph, SlotSize) {
+	Graph graph(diamond());
+	EXPECT_EQ(graph.slotSize(graph.node(Graph::Kind::input, 0)), 4u);
+	EXPECT_EQ(graph.slotSize(graph.node(Graph::Kind::processing, 0)), 3u);
+	EXPECT_EQ(graph.slotSize(graph.node(Graph::Kind::processing, 2)), 1u);
+	EXPECT_EQ(graph.slotSize(graph.node(Graph::Kind::output, 0)), 0u);
+}
+
+TEST(Graph, StageCount) {
+	// Every path through the graph holds its own reference
+	Graph graph(diamond());
+	EXPECT_EQ(graph.stageCount(graph.node(Graph::Kind::processing, 2)), 1u);
+	EXPECT_EQ(graph.stageCount(graph.node(Graph::Kind::processing, 0)), 4u);
+	EXPECT_EQ(graph.stageCount(graph.node(Graph::Kind::input, 0)), 5u);
+}
+
+TEST(Graph, QueueIds) {
+	// Output queues come first, processing queues follow
+	Graph graph(diamond());
+	EXPECT_EQ(graph.queueIds(graph.node(Graph::Kind::input, 0)), std::vector<size_t>({1}));
+	EXPECT_EQ(graph.queueIds(graph.node(Graph::Kind::processing, 0)), std::vector<size_t>({2, 0}));
+	EXPECT_EQ(graph.queueIds(graph.node(Graph::Kind::processing, 2)), std::vector<size_t>({0}));
+	EXPECT_TRUE(graph.queueIds(graph.node(Graph::Kind::output, 0)).empty());
+}
+
+TEST(Graph, LongChain) {
+	// Exponential in paths, linear to compile
+	constexpr size_t kLinks = 40;
+	Graph graph(chain(kLinks));
+	ASSERT_TRUE(graph.acyclic());
+
+	size_t in = graph.node(Graph::Kind::input, 0);
+	EXPECT_EQ(graph.slotSize(in), 2 * kLinks + 2);
+
+	// Paths from p(k) to the output: s(k) = 2 * (s(k + 1) + 2), s(links) = 1
+	size_t stages = 1;
+	for (size_t link = 0; link < kLinks; ++link) {
+		stages = 2 * (stages + 2);
+	}
+	EXPECT_EQ(graph.stageCount(in), stages + 1);
+}
+
+TEST(Graph, Cycle) {
+	auto config = diamond();
+	config["processing"][2]["out"] = {"out", "a"};
+	Graph graph(config);
+	EXPECT_FALSE(graph.acyclic());
+	EXPECT_EQ(graph.cycle(), std::vector<std::string>({"a", "b", "c", "a"}));
+}
+
+TEST(Graph, SelfLoop) {
+	auto config = diamond();
+	config["processing"][1]["out"] = {"b", "c"};
+	Graph graph(config);
+	EXPECT_FALSE(graph.acyclic());
+	EXPECT_EQ(graph.cycle(), std::vector<std::string>({"b", "b"}));
+}
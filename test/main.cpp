@@ -0,0 +1,14 @@
+#include <glog/logging.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+int main(int argc, char** argv) {
+	testing::InitGoogleTest(&argc, argv);
+	google::InitGoogleLogging(argv[0]);
+	gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+	// Validation failures are expected, keep the output readable
+	FLAGS_minloglevel = google::GLOG_FATAL;
+
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include "module.h"
+#include "slot.h"
+
+using namespace Sight;
+
+namespace {
+
+// Exposes the handle helpers
+class Access
+	: public Module {
+public:
+	using Module::pack;
+	using Module::unpack;
+};
+
+}
+
+TEST(Module, PackRoundTrip) {
+	for (uint16_t stream : {0, 1, 255, 256, 65535}) {
+		for (uint16_t slot : {0, 1, 255, 256, 65535}) {
+			for (uint32_t generation : {0u, 1u, 0xffu, 0x100u, Slot::kGenerationMask}) {
+				for (bool flag : {false, true}) {
+					uint16_t s = 0;
+					uint16_t i = 0;
+					uint32_t g = 0;
+					bool f = !flag;
+					Access::unpack(Access::pack(stream, slot, generation, flag), s, i, g, f);
+					EXPECT_EQ(s, stream);
+					EXPECT_EQ(i, slot);
+					EXPECT_EQ(g, generation);
+					EXPECT_EQ(f, flag);
+				}
+			}
+		}
+	}
+}
+
+TEST(Module, PackIsUnique) {
+	EXPECT_NE(Access::pack(1, 0, 0, false), Access::pack(0, 1, 0, false));
+	EXPECT_NE(Access::pack(0, 1, 0, false), Access::pack(0, 1, 0, true));
+	EXPECT_NE(Access::pack(0, 255, 0, true), Access::pack(1, 0, 0, true));
+	EXPECT_NE(Access::pack(0, 65535, 0, true), Access::pack(1, 0, 0, true));
+	EXPECT_NE(Access::pack(0, 1, 1, false), Access::pack(0, 1, 2, false));
+}
+
+TEST(Module, PackWrapsGeneration) {
+	uint16_t s = 0;
+	uint16_t i = 0;
+	uint32_t g = 0;
+	bool f = false;
+	Access::unpack(Access::pack(7, 9, Slot::kGenerationMask + 2, true), s, i, g, f);
+	EXPECT_EQ(s, 7);
+	EXPECT_EQ(i, 9);
+	EXPECT_EQ(g, 1u);
+	EXPECT_TRUE(f);
+}
+
+TEST(Module, Validate) {
+	EXPECT_TRUE(Module::validate({{"name", "node"}, {"type", "dummy"}}));
+	EXPECT_FALSE(Module::validate({{"type", "dummy"}}));
+	EXPECT_FALSE(Module::validate({{"name", "node"}, {"type", 1}}));
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "output/dummy.h"
+
+using namespace Sight;
+
+namespace {
+
+// Records events instead of sending them
+class Recorder
+	: public Output::Dummy {
+public:
+	using Dummy::Dummy;
+	using Dummy::pack;
+	using Dummy::task;
+	using Dummy::start;
+	using Dummy::stop;
+
+	std::vector<size_t> mSent;
+
+protected:
+	bool send(Event& event) override {
+		mSent.push_back(event.mStreamId);
+		return true;
+	}
+};
+
+// Two segments of one file, one slot each and the output as the only stage
+std::vector<std::vector<Slot>> segments() {
+	std::vector<std::vector<Slot>> slot(2);
+	for (size_t streamId = 0; streamId < slot.size(); ++streamId) {
+		slot[streamId].emplace_back(streamId, "file#" + std::to_string(streamId), 1);
+	}
+	return slot;
+}
+
+json config() {
+	return {{"name", "out"}, {"type", "dummy"}, {"segments", json::array({json::array({0, 1})})}};
+}
+
+Handle event(std::vector<std::vector<Slot>>& slot, uint16_t streamId) {
+	AVFrame* frame = slot[streamId][0].source();
+	frame->format = AV_PIX_FMT_YUVJ420P;
+	frame->width = 16;
+	frame->height = 16;
+	frame->pts = 1;
+	frame->pkt_dts = 1;
+	if (!frame->buf[0]) {
+		av_frame_get_buffer(frame, 0);
+	}
+	slot[streamId][0].reset();
+	return Recorder::pack(streamId, 0, slot[streamId][0].generation(), true);
+}
+
+}
+
+TEST(Output, HoldsLaterSegments) {
+	auto slot = segments();
+	Queue<Handle> queue;
+	Recorder output(config(), 0, slot, queue);
+	ASSERT_TRUE(output.start());
+
+	// The later segment's event is held, its slot goes back to the input
+	queue.put(event(slot, 1));
+	output.task();
+	EXPECT_TRUE(slot[1][0].ready());
+
+	queue.put(event(slot, 0));
+	output.task();
+	output.finish(0);
+	output.task();
+	output.stop();
+	EXPECT_EQ(output.mSent, std::vector<size_t>({0, 1}));
+}
+
+TEST(Output, StopSendsHeldEvents) {
+	auto slot = segments();
+	Queue<Handle> queue;
+	Recorder output(config(), 0, slot, queue);
+	ASSERT_TRUE(output.start());
+
+	queue.put(event(slot, 1));
+	output.task();
+	output.stop();
+	EXPECT_EQ(output.mSent, std::vector<size_t>({1}));
+}
+
+TEST(Output, DropsStaleHandles) {
+	auto slot = segments();
+	Queue<Handle> queue;
+	Recorder output(config(), 0, slot, queue);
+	ASSERT_TRUE(output.start());
+
+	// A handle of the previous generation must not release the current frame
+	Handle handle = event(slot, 0);
+	slot[0][0].unref();
+	queue.put(handle);
+	event(slot, 0);
+	output.task();
+	EXPECT_FALSE(slot[0][0].ready());
+	output.stop();
+	EXPECT_TRUE(output.mSent.empty());
+	slot[0][0].unref();
+}
@@ -0,0 +1,229 @@
+#include <gtest/gtest.h>
+
+#include "pipeline.h"
+
+using namespace Sight;
+
+namespace {
+
+json input(const std::string& name, const json& out) {
+	return {{"name", name}, {"type", "dummy"}, {"live", false}, {"out", out}};
+}
+
+json processing(const std::string& name, const json& out) {
+	return {{"name", name}, {"type", "dummy"}, {"out", out}};
+}
+
+json output(const std::string& name) {
+	return {{"name", name}, {"type", "dummy"}};
+}
+
+json pipeline(const std::vector<json>& inputs, const std::vector<json>& processings, const std::vector<json>& outputs) {
+	return {
+		{"name", "pipeline"}, {"type", "video"},
+		{"input", inputs}, {"processing", processings}, {"output", outputs}
+	};
+}
+
+// input -> a -> output
+json line() {
+	return pipeline({input("in", {"a"})}, {processing("a", {"out"})}, {output("out")});
+}
+
+// input -> a -> b -> c -> output, a also feeds the output directly
+json diamond() {
+	return pipeline({input("in", {"a"})},
+	                {processing("a", {"b", "out"}), processing("b", {"c"}), processing("c", {"out"})},
+	                {output("out")});
+}
+
+}
+
+TEST(Pipeline, ValidateLine) {
+	EXPECT_TRUE(Pipeline::validate(line()));
+}
+
+TEST(Pipeline, ValidateDiamond) {
+	EXPECT_TRUE(Pipeline::validate(diamond()));
+}
+
+TEST(Pipeline, ValidateMissingSections) {
+	auto config = line();
+	config.erase("input");
+	EXPECT_FALSE(Pipeline::validate(config));
+
+	config = line();
+	config["processing"] = json::array();
+	EXPECT_FALSE(Pipeline::validate(config));
+
+	config = line();
+	config["output"] = json::object();
+	EXPECT_FALSE(Pipeline::validate(config));
+}
+
+TEST(Pipeline, ValidateNames) {
+	auto config = line();
+	config["output"][0]["name"] = "a";
+	config["processing"][0]["out"] = {"a"};
+	EXPECT_FALSE(Pipeline::validate(config));
+
+	config = pipeline({input("in", {"a"}), input("in", {"a"})}, {processing("a", {"out"})}, {output("out")});
+	EXPECT_FALSE(Pipeline::validate(config));
+}
+
+TEST(Pipeline, ValidateConnections) {
+	// Unknown target
+	auto config = pipeline({input("in", {"x"})}, {processing("a", {"out"})}, {output("out")});
+	EXPECT_FALSE(Pipeline::validate(config));
+
+	// Input straight into an output
+	config = pipeline({input("in", {"out"})}, {processing("a", {"out"})}, {output("out")});
+	EXPECT_FALSE(Pipeline::validate(config));
+
+	// Output nobody writes to
+	config = pipeline({input("in", {"a"})}, {processing("a", {"out"})}, {output("out"), output("idle")});
+	EXPECT_FALSE(Pipeline::validate(config));
+
+	// Unknown node type
+	config = line();
+	config["processing"][0]["type"] = "unknown";
+	EXPECT_FALSE(Pipeline::validate(config));
+}
+
+TEST(Pipeline, ValidateConcatStreams) {
+	auto config = pipeline({input("in-0", {"a"}), input("in-1", {"a"})}, {processing("a", {"out"})}, {output("out")});
+	config["processing"][0]["concat"] = {{"streams", {"in-0", "in-1"}}};
+	EXPECT_TRUE(Pipeline::validate(config));
+
+	config["processing"][0]["concat"] = {{"streams", {"in-0", "a"}}};
+	EXPECT_FALSE(Pipeline::validate(config));
+}
+
+TEST(Pipeline, ValidateSlots) {
+	auto config = line();
+	config["input"][0]["slots"] = {{"min", 2u}, {"max", 8u}};
+	EXPECT_TRUE(Pipeline::validate(config));
+
+	config["input"][0]["slots"] = {{"max", 8u}};
+	EXPECT_TRUE(Pipeline::validate(config));
+
+	config["input"][0]["slots"] = {{"min", 8u}, {"max", 2u}};
+	EXPECT_FALSE(Pipeline::validate(config));
+
+	config["input"][0]["slots"] = {{"min", 0u}};
+	EXPECT_FALSE(Pipeline::validate(config));
+
+	config["input"][0]["slots"] = {{"max", 70000u}};
+	EXPECT_FALSE(Pipeline::validate(config));
+}
+
+TEST(Pipeline, ValidateThread) {
+	// Module settings complete the pipeline defaults
+	auto config = line();
+	config["thread"] = {{"policy", "fifo"}};
+	config["processing"][0]["thread"] = {{"priority", 10u}};
+	EXPECT_TRUE(Pipeline::validate(config));
+
+	config["thread"] = {{"policy", "fifo"}, {"priority", 10u}};
+	config["processing"][0]["thread"] = {{"policy", "other"}};
+	EXPECT_FALSE(Pipeline::validate(config));
+}
+
+TEST(Pipeline, Expand) {
+	auto config = line();
+	config["input"][0]["copies"] = 3u;
+	auto expanded = Pipeline::expand(config);
+	ASSERT_EQ(expanded["input"].size(), 3u);
+	EXPECT_EQ(expanded["input"][0]["name"], "in-0");
+	EXPECT_EQ(expanded["input"][2]["name"], "in-2");
+	EXPECT_FALSE(expanded["input"][1].contains("copies"));
+	EXPECT_TRUE(Pipeline::validate(expanded));
+}
+
+TEST(Pipeline, ExpandRenamesStreams) {
+	auto config = pipeline({input("in", {"a"}), input("other", {"a"})}, {processing("a", {"out"})}, {output("out")});
+	config["processing"][0]["concat"] = {{"streams", {"in", "other"}}};
+	config["processing"][0]["roi"] = {{{"stream", "in"}, {"x", 0.0}, {"y", 0.0}, {"width", 0.5}, {"height", 0.5}}};
+	config["input"][0]["copies"] = 2u;
+	auto expanded = Pipeline::expand(config);
+	EXPECT_EQ(expanded["processing"][0]["concat"]["streams"], json({"in-0", "in-1", "other"}));
+	ASSERT_EQ(expanded["processing"][0]["roi"].size(), 2u);
+	EXPECT_EQ(expanded["processing"][0]["roi"][1]["stream"], "in-1");
+	EXPECT_TRUE(Pipeline::validate(expanded));
+
+	config["input"][0].erase("copies");
+	config["input"][0]["segments"] = 2u;
+	expanded = Pipeline::expand(config);
+	ASSERT_EQ(expanded["processing"].size(), 2u);
+	EXPECT_EQ(expanded["processing"][1]["concat"]["streams"], json({"in#1", "other"}));
+	EXPECT_EQ(expanded["processing"][1]["roi"][0]["stream"], "in#1");
+}
+
+TEST(Pipeline, ExpandSegments) {
+	auto config = diamond();
+	config["input"][0]["segments"] = 2u;
+	auto expanded = Pipeline::expand(config);
+	ASSERT_EQ(expanded["input"].size(), 2u);
+	EXPECT_EQ(expanded["input"][1]["name"], "in#1");
+	EXPECT_EQ(expanded["input"][1]["out"], json({"a#1"}));
+	EXPECT_EQ(expanded["input"][1]["segment"]["index"], 1);
+	EXPECT_EQ(expanded["input"][1]["segment"]["count"], 2);
+	ASSERT_EQ(expanded["processing"].size(), 6u);
+	EXPECT_EQ(expanded["processing"][0]["name"], "a#0");
+	EXPECT_EQ(expanded["processing"][0]["out"], json({"b#0", "out"}));
+	EXPECT_EQ(expanded["processing"][5]["out"], json({"out"}));
+	EXPECT_TRUE(Pipeline::validate(expanded));
+
+	// Live inputs have no end to split
+	config["input"][0]["live"] = true;
+	expanded = Pipeline::expand(config);
+	EXPECT_EQ(expanded["input"].size(), 1u);
+	EXPECT_FALSE(Pipeline::validate(expanded));
+}
+
+TEST(Pipeline, ValidateCycle) {
+	auto config = diamond();
+	config["processing"][2]["out"] = {"out", "a"};
+	EXPECT_FALSE(Pipeline::validate(config));
+
+	config = line();
+	config["processing"][0]["out"] = {"out", "a"};
+	EXPECT_FALSE(Pipeline::validate(config));
+}
+
+TEST(Pipeline, Reconfigure) {
+	auto config = line();
+	Pipeline pipeline(config, 0);
+	EXPECT_EQ(pipeline.config(), config);
+
+	// Delay and drop are applied in place
+	config["processing"][0]["delay"] = 10;
+	config["processing"][0]["drop"] = true;
+	EXPECT_TRUE(pipeline.reconfigure(config));
+	EXPECT_EQ(pipeline.config(), config);
+
+	// Graph changes need a rebuild
+	auto changed = config;
+	changed["processing"][0]["out"] = {"out", "other"};
+	changed["output"].push_back(output("other"));
+	EXPECT_FALSE(pipeline.reconfigure(changed));
+
+	EXPECT_EQ(pipeline.config(), config);
+
+	// Inputs are added, changed and removed while the others stay
+	changed = config;
+	changed["input"].push_back(input("second", {"a"}));
+	EXPECT_TRUE(pipeline.reconfigure(changed));
+	EXPECT_EQ(pipeline.config(), changed);
+	changed["input"][0]["live"] = true;
+	EXPECT_TRUE(pipeline.reconfigure(changed));
+	EXPECT_TRUE(pipeline.reconfigure(config));
+	EXPECT_EQ(pipeline.config(), config);
+
+	// Concat groups are fixed when the pipeline is built
+	auto concat = config;
+	concat["processing"][0]["concat"] = json::object();
+	Pipeline grouped(concat, 1);
+	concat["input"].push_back(input("second", {"a"}));
+	EXPECT_FALSE(grouped.reconfigure(concat));
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+#include "processing/dummy.h"
+
+using namespace Sight;
+
+namespace {
+
+// Reports only frames of the first stream
+class Reporter
+	: public Processing::Dummy {
+public:
+	using Dummy::Dummy;
+	using Dummy::pack;
+	using Dummy::unpack;
+	using Dummy::task;
+
+protected:
+	bool detect(Slot& slot) override {
+		return slot.streamId() == 0;
+	}
+};
+
+}
+
+TEST(Processing, ConcatForwardsEachMember) {
+	std::vector<std::vector<Slot>> slot(2);
+	slot[0].emplace_back(0, "a", 1);
+	slot[1].emplace_back(1, "b", 1);
+	Queue<Handle> queueIn;
+	std::vector<Queue<Handle>> queueOut(1);
+	std::vector<size_t> queueOutId = {0};
+	json config = {{"name", "fusion"}, {"type", "dummy"}, {"concat", json::object()}};
+	Reporter processing(config, 0, slot, queueIn, queueOut, queueOutId);
+
+	for (uint16_t streamId = 0; streamId < 2; ++streamId) {
+		slot[streamId][0].source()->pts = 1;
+		slot[streamId][0].source()->pkt_dts = 1;
+		slot[streamId][0].reset();
+		queueIn.put(Reporter::pack(streamId, 0, slot[streamId][0].generation(), true));
+		processing.task();
+	}
+
+	// The silent member does not hold back the one that reported
+	ASSERT_EQ(queueOut[0].size(), 2u);
+	std::map<uint16_t, bool> process;
+	while (queueOut[0].size() > 0) {
+		uint16_t streamId = 0;
+		uint16_t slotId = 0;
+		uint32_t generation = 0;
+		bool flag = false;
+		Reporter::unpack(queueOut[0].get(), streamId, slotId, generation, flag);
+		process[streamId] = flag;
+	}
+	EXPECT_TRUE(process[0]);
+	EXPECT_FALSE(process[1]);
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "queue.h"
+
+using namespace Sight;
+
+TEST(Queue, Fifo) {
+	Queue<int> queue;
+	EXPECT_EQ(queue.size(), 0u);
+	EXPECT_FALSE(queue.ready(0));
+
+	for (int i = 0; i < 10; ++i) {
+		queue.put(i);
+	}
+	EXPECT_EQ(queue.size(), 10u);
+	EXPECT_TRUE(queue.ready(0));
+
+	EXPECT_EQ(queue.first(), 0);
+	queue.remove();
+	for (int i = 1; i < 10; ++i) {
+		EXPECT_EQ(queue.get(), i);
+	}
+	EXPECT_EQ(queue.size(), 0u);
+}
+
+TEST(Queue, Move) {
+	Queue<std::vector<int>> queue;
+	std::vector<int> value = {1, 2, 3};
+	queue.put(std::move(value));
+	Queue<std::vector<int>> other(std::move(queue));
+	EXPECT_EQ(other.size(), 1u);
+	EXPECT_EQ(other.get(), std::vector<int>({1, 2, 3}));
+}
+
+TEST(Queue, ReadyWakesOnNotify) {
+	Queue<int> queue;
+	std::thread producer([&queue] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		queue.put(42);
+		queue.notify();
+	});
+	EXPECT_TRUE(queue.ready(5000));
+	EXPECT_EQ(queue.get(), 42);
+	producer.join();
+}
+
+// Many producers and a single consumer, as every pipeline queue is used
+TEST(QueueStress, ManyProducers) {
+	constexpr int kProducers = 8;
+	constexpr int kCount = 20000;
+
+	Queue<uint32_t> queue;
+	std::vector<std::thread> producers;
+	for (int p = 0; p < kProducers; ++p) {
+		producers.emplace_back([&queue, p] {
+			for (int i = 0; i < kCount; ++i) {
+				queue.put((p << 24) | i);
+				queue.notify();
+			}
+		});
+	}
+
+	std::vector<int> next(kProducers, 0);
+	int received = 0;
+	while (received < kProducers * kCount) {
+		if (!queue.ready(1000)) {
+			continue;
+		}
+		uint32_t e = queue.get();
+		int p = e >> 24;
+		int i = e & 0xffffff;
+		ASSERT_LT(p, kProducers);
+		// Order is kept per producer
+		ASSERT_EQ(i, next[p]);
+		++next[p];
+		++received;
+	}
+
+	for (auto& producer : producers) {
+		producer.join();
+	}
+	EXPECT_EQ(queue.size(), 0u);
+}
@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "queue.h"
+#include "slot.h"
+
+using namespace Sight;
+
+TEST(Slot, ReadyAfterAllStages) {
+	Slot slot(0, "stream", 3);
+	EXPECT_TRUE(slot.ready());
+
+	slot.source()->pts = 1;
+	slot.source()->pkt_dts = 1;
+	slot.reset();
+	EXPECT_FALSE(slot.ready());
+
+	slot.unref();
+	slot.unref();
+	EXPECT_FALSE(slot.ready());
+	slot.unref();
+	EXPECT_TRUE(slot.ready());
+}
+
+TEST(Slot, FreshUntilReleased) {
+	Slot slot(0, "stream", 1);
+	slot.source()->width = 16;
+	slot.source()->height = 16;
+	slot.source()->pts = 1;
+	slot.source()->pkt_dts = 1;
+	slot.reset();
+	EXPECT_TRUE(slot.fresh());
+	slot.unref();
+	EXPECT_FALSE(slot.fresh());
+
+	// Same size and growing timestamps keep the slot warm
+	slot.source()->pts = 2;
+	slot.source()->pkt_dts = 2;
+	slot.reset();
+	EXPECT_FALSE(slot.fresh());
+	slot.unref();
+
+	// Timestamps going back mean a new stream
+	slot.source()->pts = 1;
+	slot.source()->pkt_dts = 1;
+	slot.reset();
+	EXPECT_TRUE(slot.fresh());
+	slot.unref();
+}
+
+TEST(Slot, Info) {
+	Slot slot(0, "stream", 1);
+	slot.source()->pts = 1;
+	slot.source()->pkt_dts = 1;
+	slot.reset();
+	slot.info("detect")["count"] = 2;
+	EXPECT_EQ(slot.info()["detect"]["count"], 2);
+	slot.unref();
+	EXPECT_TRUE(slot.info().empty());
+}
+
+TEST(Slot, Timestamp) {
+	Slot slot(0, "stream", 1);
+	slot.source()->pts = 50;
+	slot.source()->pkt_dts = 50;
+	slot.reset({1, 25});
+	EXPECT_EQ(slot.timestamp(), 2000000);
+	slot.unref();
+}
+
+TEST(Slot, GenerationPerReset) {
+	Slot slot(0, "stream", 1);
+	uint32_t generation = slot.generation();
+	for (int i = 1; i <= 3; ++i) {
+		slot.source()->pts = i;
+		slot.source()->pkt_dts = i;
+		slot.reset();
+		EXPECT_EQ(slot.generation(), (generation + i) & Slot::kGenerationMask);
+		slot.unref();
+	}
+	// Release does not recycle yet, handles of the last frame stay valid
+	EXPECT_EQ(slot.generation(), (generation + 3) & Slot::kGenerationMask);
+}
+
+TEST(Slot, ReleaseDropsBuffers) {
+	Slot slot(0, "stream", 1);
+	EXPECT_EQ(slot.memory(), 0u);
+
+	AVFrame* frame = slot.source();
+	frame->format = AV_PIX_FMT_YUV420P;
+	frame->width = 64;
+	frame->height = 32;
+	ASSERT_GE(av_frame_get_buffer(frame, 0), 0);
+	frame->pts = 1;
+	frame->pkt_dts = 1;
+	slot.reset();
+	EXPECT_EQ(slot.memory(), 64u * 32u * 3u / 2u);
+	slot.unref();
+
+	slot.release();
+	EXPECT_EQ(slot.memory(), 0u);
+	EXPECT_EQ(slot.source()->buf[0], nullptr);
+}
+
+TEST(Slot, WaitBlocksUntilReleased) {
+	Slot slot(0, "stream", 1);
+	slot.source()->pts = 1;
+	slot.source()->pkt_dts = 1;
+	slot.reset();
+
+	std::atomic_bool released = false;
+	std::thread stage([&slot, &released] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		released = true;
+		slot.unref();
+	});
+	slot.wait();
+	EXPECT_TRUE(released);
+	EXPECT_TRUE(slot.ready());
+	stage.join();
+}
+
+// One producer refills a small ring while several stages release slots concurrently
+TEST(SlotStress, RingUnderContention) {
+	constexpr size_t kStages = 4;
+	constexpr size_t kSlots = 2;
+	constexpr int kFrames = 20000;
+
+	std::vector<Slot> slots;
+	for (size_t id = 0; id < kSlots; ++id) {
+		slots.push_back(Slot(0, "stream", kStages));
+	}
+	std::vector<Queue<int>> queues(kStages);
+
+	std::atomic_int mismatch = 0;
+	std::vector<std::thread> stages;
+	for (size_t stage = 0; stage < kStages; ++stage) {
+		stages.emplace_back([&, stage] {
+			for (int frame = 0; frame < kFrames; ++frame) {
+				while (!queues[stage].ready(1000)) {
+				}
+				int number = queues[stage].get();
+				auto& slot = slots[number % kSlots];
+				// The producer must not touch a slot before every stage released it
+				if (slot.source()->pts != number + 1 || slot.ready()) {
+					++mismatch;
+				}
+				slot.unref();
+			}
+		});
+	}
+
+	for (int frame = 0; frame < kFrames; ++frame) {
+		auto& slot = slots[frame % kSlots];
+		if (!slot.ready()) {
+			slot.wait();
+		}
+		slot.source()->pts = frame + 1;
+		slot.source()->pkt_dts = frame + 1;
+		slot.reset();
+		for (auto& queue : queues) {
+			queue.put(frame);
+			queue.notify();
+		}
+	}
+
+	for (auto& stage : stages) {
+		stage.join();
+	}
+	EXPECT_EQ(mismatch, 0);
+	for (auto& slot : slots) {
+		EXPECT_TRUE(slot.ready());
+	}
+}
@@ -0,0 +1,88 @@
+#ifdef INPUT_STREAM
+
+#include <gtest/gtest.h>
+
+#include "input/source.h"
+
+using namespace Sight;
+
+namespace {
+
+AVFrame* frame(int64_t pts) {
+	AVFrame* f = av_frame_alloc();
+	f->width = 16;
+	f->height = 16;
+	f->format = AV_PIX_FMT_GRAY8;
+	av_frame_get_buffer(f, 0);
+	f->pts = pts;
+	return f;
+}
+
+}
+
+TEST(Source, FirstAttachLeads) {
+	int a = 0;
+	int b = 0;
+	bool leader = false;
+	auto source = Input::Source::attach("rtsp://camera {}", &a, leader);
+	EXPECT_TRUE(leader);
+	EXPECT_EQ(Input::Source::attach("rtsp://camera {}", &b, leader), source);
+	EXPECT_FALSE(leader);
+	EXPECT_NE(Input::Source::attach("rtsp://other {}", &b, leader), source);
+	EXPECT_TRUE(leader);
+	source->detach(&b);
+	source->detach(&a);
+}
+
+TEST(Source, FollowersShareBuffers) {
+	int a = 0;
+	int b = 0;
+	int c = 0;
+	bool leader = false;
+	auto source = Input::Source::attach("shared {}", &a, leader);
+	Input::Source::attach("shared {}", &b, leader);
+	Input::Source::attach("shared {}", &c, leader);
+
+	AVFrame* in = frame(7);
+	source->publish(in, {1, 90000});
+	AVFrame* out = av_frame_alloc();
+	size_t dropped = 0;
+	for (int* follower : {&b, &c}) {
+		ASSERT_EQ(source->receive(follower, out, std::chrono::milliseconds(0), dropped), Input::Source::Receive::frame);
+		EXPECT_EQ(out->pts, 7);
+		EXPECT_EQ(out->data[0], in->data[0]);
+		EXPECT_EQ(dropped, 0u);
+	}
+	EXPECT_EQ(source->receive(&b, out, std::chrono::milliseconds(0), dropped), Input::Source::Receive::empty);
+	EXPECT_EQ(source->timeBase().den, 90000);
+
+	source->detach(&a);
+	EXPECT_EQ(source->receive(&b, out, std::chrono::milliseconds(0), dropped), Input::Source::Receive::closed);
+	av_frame_free(&out);
+	av_frame_free(&in);
+}
+
+TEST(Source, SlowFollowerDropsOldest) {
+	int a = 0;
+	int b = 0;
+	bool leader = false;
+	auto source = Input::Source::attach("slow {}", &a, leader);
+	Input::Source::attach("slow {}", &b, leader);
+
+	AVFrame* in = frame(0);
+	for (int64_t pts = 0; pts < 5; ++pts) {
+		in->pts = pts;
+		source->publish(in, {1, 25});
+	}
+	AVFrame* out = av_frame_alloc();
+	size_t dropped = 0;
+	ASSERT_EQ(source->receive(&b, out, std::chrono::milliseconds(0), dropped), Input::Source::Receive::frame);
+	EXPECT_EQ(out->pts, 3);
+	EXPECT_EQ(dropped, 3u);
+	source->detach(&b);
+	source->detach(&a);
+	av_frame_free(&out);
+	av_frame_free(&in);
+}
+
+#endif
@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+
+#include "thread.h"
+
+using namespace Sight;
+
+TEST(Thread, ParseCpuList) {
+	std::vector<int> cpus;
+	ASSERT_TRUE(Thread::parse("0-3,8", cpus));
+	EXPECT_EQ(cpus, std::vector<int>({0, 1, 2, 3, 8}));
+	ASSERT_TRUE(Thread::parse("5", cpus));
+	EXPECT_EQ(cpus, std::vector<int>({5}));
+	EXPECT_FALSE(Thread::parse("", cpus));
+	EXPECT_FALSE(Thread::parse("3-1", cpus));
+	EXPECT_FALSE(Thread::parse("a", cpus));
+	EXPECT_FALSE(Thread::parse("0-3x", cpus));
+	EXPECT_FALSE(Thread::parse("5x", cpus));
+	EXPECT_FALSE(Thread::parse("1,2-", cpus));
+}
+
+TEST(Thread, Validate) {
+	EXPECT_TRUE(Thread::validate({{"cpus", "0"}, {"nice", 5}}));
+	EXPECT_TRUE(Thread::validate({{"policy", "fifo"}, {"priority", 10u}}));
+	EXPECT_TRUE(Thread::validate({{"node", 0u}, {"placement", "node"}}));
+	EXPECT_FALSE(Thread::validate({{"cpus", 0}}));
+	EXPECT_FALSE(Thread::validate({{"policy", "fast"}}));
+	EXPECT_FALSE(Thread::validate({{"priority", 10u}}));
+	EXPECT_TRUE(Thread::validate({{"priority", 10u}}, true));
+	EXPECT_FALSE(Thread::validate({{"nice", 20}}));
+	EXPECT_FALSE(Thread::validate({{"node", Thread::nodes()}}));
+	EXPECT_FALSE(Thread::validate({{"placement", "socket"}}));
+}
+
+TEST(Thread, ApplyKeepsRunning) {
+	// Pinning the calling thread to its current cpu always succeeds
+	int cpu = sched_getcpu();
+	Thread thread(json({{"cpus", std::to_string(cpu)}}));
+	thread.apply("test");
+	EXPECT_EQ(sched_getcpu(), cpu);
+}